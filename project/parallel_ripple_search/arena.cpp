@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include <map>
+
+#include "arena.h"
+
+using namespace std;
+
+struct Region {
+	size_t bytes;
+	int mode; //PAGES_THP or PAGES_HUGETLB, what it ended up as
+};
+
+static int currentMode = PAGES_SMALL;
+//the arena's mappings by start address, anything else arenaFree sees is malloc's
+static map<uintptr_t, Region> regions;
+static size_t mappedBytes[3] = {0, 0, 0};
+static bool warnedPool = false;
+static pthread_mutex_t regionsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+void setPageMode(int mode) {
+	currentMode = mode;
+}
+
+int pageMode() {
+	return currentMode;
+}
+
+const char* pageModeName(int mode) {
+	switch (mode) {
+		case PAGES_THP: return "thp";
+		case PAGES_HUGETLB: return "hugetlb";
+	}
+	return "small";
+}
+
+int pageModeNamed(const char* name) {
+	if (strcmp(name, "thp") == 0) return PAGES_THP;
+	if (strcmp(name, "hugetlb") == 0) return PAGES_HUGETLB;
+	if (strcmp(name, "small") == 0) return PAGES_SMALL;
+	return -1;
+}
+
+static void record(void* start, size_t bytes, int mode) {
+	Region region = {bytes, mode};
+	pthread_mutex_lock(&regionsMutex);
+	regions[(uintptr_t)start] = region;
+	mappedBytes[mode] += bytes;
+	pthread_mutex_unlock(&regionsMutex);
+}
+
+//a zeroed mapping of whole huge pages, NULL if not even a THP one could be made
+static void* mapHuge(size_t bytes, int mode) {
+	size_t rounded = (bytes + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1);
+	if (mode == PAGES_HUGETLB) {
+		void* pages = mmap(NULL, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (pages != MAP_FAILED) {
+			record(pages, rounded, PAGES_HUGETLB);
+			return pages;
+		}
+		pthread_mutex_lock(&regionsMutex);
+		if (!warnedPool) {
+			fprintf(stderr, "The huge page pool can't hold %zu MB, using transparent huge pages\n", rounded >> 20);
+			warnedPool = true;
+		}
+		pthread_mutex_unlock(&regionsMutex);
+	}
+	//one huge page more than needed, so an aligned start fits, then the ends are given back
+	size_t span = rounded + HUGE_PAGE_BYTES;
+	char* raw = (char*)mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED) return NULL;
+	char* aligned = (char*)((((uintptr_t)raw) + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1));
+	if (aligned > raw) munmap(raw, aligned - raw);
+	size_t tail = (raw + span) - (aligned + rounded);
+	if (tail > 0) munmap(aligned + rounded, tail);
+	//without THP (or with it set to never) this does nothing, and the pages stay small
+	madvise(aligned, rounded, MADV_HUGEPAGE);
+	record(aligned, rounded, PAGES_THP);
+	return aligned;
+}
+
+void* arenaCalloc(size_t count, size_t size) {
+	size_t bytes = count * size;
+	if (currentMode != PAGES_SMALL && bytes >= HUGE_PAGE_BYTES) {
+		void* block = mapHuge(bytes, currentMode);
+		if (block != NULL) return block;
+	}
+	return calloc(count, size);
+}
+
+void* arenaRealloc(void* block, size_t oldBytes, size_t newBytes) {
+	pthread_mutex_lock(&regionsMutex);
+	map<uintptr_t, Region>::iterator found = regions.find((uintptr_t)block);
+	bool mapped = found != regions.end();
+	size_t capacity = mapped ? found->second.bytes : 0;
+	pthread_mutex_unlock(&regionsMutex);
+	if (mapped && newBytes <= capacity) return block;
+	if (!mapped && (currentMode == PAGES_SMALL || newBytes < HUGE_PAGE_BYTES)) return realloc(block, newBytes);
+	void* grown = arenaCalloc(newBytes, 1);
+	memcpy(grown, block, oldBytes);
+	arenaFree(block);
+	return grown;
+}
+
+void arenaFree(void* block) {
+	if (block == NULL) return;
+	pthread_mutex_lock(&regionsMutex);
+	map<uintptr_t, Region>::iterator found = regions.find((uintptr_t)block);
+	if (found == regions.end()) {
+		pthread_mutex_unlock(&regionsMutex);
+		free(block);
+		return;
+	}
+	Region region = found->second;
+	regions.erase(found);
+	mappedBytes[region.mode] -= region.bytes;
+	pthread_mutex_unlock(&regionsMutex);
+	munmap(block, region.bytes);
+}
+
+size_t arenaBytes(int mode) {
+	pthread_mutex_lock(&regionsMutex);
+	size_t bytes = mappedBytes[mode];
+	pthread_mutex_unlock(&regionsMutex);
+	return bytes;
+}
+
+size_t transparentHugeBytes() {
+	FILE* fp = fopen("/proc/self/smaps_rollup", "r");
+	if (fp == NULL) return 0;
+	char line[256];
+	size_t kb = 0;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "AnonHugePages: %zu kB", &kb) == 1) break;
+	}
+	fclose(fp);
+	return kb * 1024;
+}
@@ -0,0 +1,40 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ARENA_H
+#define ARENA_H
+
+//where the big arrays (obstacle bitsets, dense search state, fringe pools) get their pages.
+// On a 16000 map the state alone is 2GB, half a million 4KB pages, so almost every step
+// to the row above or below is a TLB miss; with 2MB pages the TLB covers hundreds of
+// times more of the map
+#define PAGES_SMALL   0 //malloc's, whatever the kernel gives it
+#define PAGES_THP     1 //2MB aligned anonymous mappings, which madvise(MADV_HUGEPAGE) asks
+                        // the kernel to back with transparent huge pages
+#define PAGES_HUGETLB 2 //huge pages reserved in vm.nr_hugepages (MAP_HUGETLB). An allocation
+                        // the pool can't cover falls back to THP
+#define HUGE_PAGE_BYTES (((size_t)2) << 20)
+
+//the mode applies to allocations made after it's set, small unless set
+void setPageMode(int mode);
+int pageMode();
+//"small", "thp" or "hugetlb", and back. Unknown names are -1
+const char* pageModeName(int mode);
+int pageModeNamed(const char* name);
+
+//calloc, except that in the huge modes allocations of at least HUGE_PAGE_BYTES are mappings
+// of their own, kept in a table so arenaFree can tell them apart. Either way big blocks
+// are zero pages until first written, so first touch placement (see numa.h) still works,
+// a huge page at a time
+void* arenaCalloc(size_t count, size_t size);
+//realloc for arenaCalloc (or malloc) blocks of oldBytes. The bytes past oldBytes aren't zeroed
+void* arenaRealloc(void* block, size_t oldBytes, size_t newBytes);
+//free for arenaCalloc blocks, and for malloc's
+void arenaFree(void* block);
+
+//bytes of the live huge page mappings of a mode, and of all memory the kernel is backing
+// with transparent huge pages (AnonHugePages in /proc/self/smaps_rollup, 0 if unreadable)
+size_t arenaBytes(int mode);
+size_t transparentHugeBytes();
+
+#endif
@@ -0,0 +1,56 @@
+#include <queue>
+#include <vector>
+
+#include "astar.h"
+#include "fringesearch.h"
+
+struct HeapEntry {
+	int f;
+	int g;
+	NodeId node;
+};
+
+//priority_queue keeps the largest on top: lowest f first, ties to the deepest node
+struct HeapOrder {
+	bool operator()(const HeapEntry& a, const HeapEntry& b) const {
+		if (a.f != b.f) return a.f > b.f;
+		return a.g < b.g;
+	}
+};
+
+list<NodeId>* astar(Map& map, coord start, coord goal, long* expansions) {
+	newSearch(map);
+	int owner = claimOwner(&map, start);
+	NodeId origin = getNode(map, start.x, start.y);
+	NodeId target = getNode(map, goal.x, goal.y);
+	*expansions = 0;
+
+	priority_queue<HeapEntry, vector<HeapEntry>, HeapOrder> open;
+	storeState(map, origin, packState(0, owner, DIR_NONE));
+	HeapEntry first = {manhattan(start, goal), 0, origin};
+	open.push(first);
+
+	while (!open.empty()) {
+		HeapEntry top = open.top();
+		open.pop();
+		//entries aren't removed when a node gets cheaper, the stale ones are skipped here
+		if (top.g > stateCost(loadState(map, top.node))) continue;
+		if (top.node == target) return getPath(map, target);
+		(*expansions)++;
+
+		coord c = coordOf(map, top.node);
+		int x[] = {c.x+1, c.x-1, c.x, c.x  };
+		int y[] = {c.y,   c.y, c.y+1, c.y-1};
+		for (int dir = 0; dir < 4; dir++) {
+			if (!validX(map, x[dir]) || !validY(map, y[dir])) continue;
+			NodeId child = neighborOf(map, top.node, dir);
+			if (isBlocked(map, child)) continue;
+			int g = top.g + 1;
+			if (g >= stateCost(loadState(map, child))) continue;
+			storeState(map, child, packState(g, owner, oppositeDir(dir)));
+			HeapEntry next = {g + manhattan(x[dir], y[dir], goal.x, goal.y), g, child};
+			open.push(next);
+		}
+	}
+	return NULL;
+}
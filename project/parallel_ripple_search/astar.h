@@ -0,0 +1,16 @@
+#include "nodemap.h"
+
+#ifndef ASTAR_H
+#define ASTAR_H
+
+#include <list>
+
+using namespace std;
+
+//sequential baseline: textbook A* with a binary heap, 4-connected and unit cost like
+// fsearch, so its path length is the optimum the ripple search is measured against.
+//It keeps its costs and parents in the map's state words, so it starts with newSearch
+// and leaves the map ready for getPath. Returns NULL if goal can't be reached
+list<NodeId>* astar(Map& map, coord start, coord goal, long* expansions);
+
+#endif
@@ -0,0 +1,435 @@
+#include "nodemap.h"
+#include "fringesearch.h"
+#include "stats.h"
+#include "components.h"
+#include "landmarks.h"
+#include "procedural.h"
+#include "arena.h"
+
+#include <omp.h>
+
+#include <math.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+//times the building blocks of a ripple search one at a time, so a regression can be
+// pinned on the piece that caused it:
+//  obsFiller     filling a map with obstacles                    work: cells
+//  highLevelMap  collapsing a filled map to the high level map   work: cells
+//  buildMap      both of the above plus the cutoff and locks     work: cells
+//                (with --procedural, buildProceduralMap instead)
+//  components    labelling the connected components              work: cells
+//  landmarks     distance fields of the --alt landmarks, if any  work: cells
+//  hlsearch      corner to corner search of the high level map   work: expansions
+//  fsearch       corner to corner single instance search         work: expansions
+//  getPath       walking the parents back from the goal          work: path cells
+//every kernel runs for each combination of the swept parameters, warm-up runs first.
+// Results are CSV, one row per kernel and combination. dtlb_misses is the data TLB load
+// misses of a repetition, counted by perf on every thread, -1 where perf can't count them
+
+struct BenchConfig {
+    vector<int> sizes;
+    vector<double> ratios;
+    vector<int> hlSides;
+    vector<int> seeds;
+    int warmup;
+    int reps;
+    int expansion; //EXPAND_ALL, or EXPAND_JUMP with --jps
+    int landmarks; //ALT landmarks the search kernels estimate with, --alt k
+    vector<int> layouts; //LAYOUT_*, by name (--layouts plain,morton)
+    int stateMode; //STATE_DENSE, or STATE_PAGED with --paged
+    bool procedural; //obstacles computed on demand, --procedural
+    vector<int> pageModes; //PAGES_*, by name (--pages small,thp)
+};
+
+//one perf counter of data TLB load misses per omp thread, each counting only its own thread
+struct TlbCounter {
+    vector<int> fds; //empty if perf isn't available
+};
+
+static TlbCounter openTlbCounter() {
+    TlbCounter counter;
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    vector<int> fds(omp_get_max_threads(), -1);
+    #pragma omp parallel
+    {
+        fds[omp_get_thread_num()] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    bool opened = true;
+    for (size_t t = 0; t < fds.size(); t++) opened = opened && fds[t] >= 0;
+    if (opened) counter.fds = fds;
+    else for (size_t t = 0; t < fds.size(); t++) if (fds[t] >= 0) close(fds[t]);
+    return counter;
+}
+
+static void switchTlbCounter(TlbCounter& counter, bool on) {
+    for (size_t t = 0; t < counter.fds.size(); t++) {
+        if (on) ioctl(counter.fds[t], PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter.fds[t], on ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, 0);
+    }
+}
+
+static double readTlbCounter(TlbCounter& counter) {
+    if (counter.fds.empty()) return -1;
+    double total = 0;
+    for (size_t t = 0; t < counter.fds.size(); t++) {
+        uint64_t count = 0;
+        if (read(counter.fds[t], &count, sizeof(count)) == sizeof(count)) total += count;
+    }
+    return total;
+}
+
+static TlbCounter tlbCounter;
+
+//one repetition: returns the seconds taken and sets work to what was done in them
+typedef double (*Kernel)(MetaMap* mmap, MapParams& params, int seed, double* work);
+
+struct Timing {
+    double mean, stddev, min, median, max;
+};
+
+static Timing summarize(vector<double>& times) {
+    Timing t;
+    sort(times.begin(), times.end());
+    int n = times.size();
+    double sum = 0;
+    for (int i = 0; i < n; i++) sum += times[i];
+    t.mean = sum / n;
+    double sq = 0;
+    for (int i = 0; i < n; i++) sq += (times[i] - t.mean) * (times[i] - t.mean);
+    t.stddev = n > 1 ? sqrt(sq / (n - 1)) : 0;
+    t.min = times[0];
+    t.max = times[n-1];
+    t.median = n % 2 ? times[n/2] : (times[n/2 - 1] + times[n/2]) / 2;
+    return t;
+}
+
+static double benchObsFiller(MetaMap* mmap, MapParams& params, int seed, double* work) {
+    Map* map = initializeMap(params);
+    Bounds* bounds = initializeBounds(params);
+    bounds->key = mixKey(seed, 0);
+    double start = omp_get_wtime();
+    #pragma omp parallel
+    #pragma omp single
+    obsFiller(*map, *bounds);
+    double taken = omp_get_wtime() - start;
+    free(bounds);
+    freeMap(map, true);
+    *work = ((double)params.sidelength) * params.sidelength;
+    return taken;
+}
+
+static double benchHighLevelMap(MetaMap* mmap, MapParams& params, int seed, double* work) {
+    double cutoff = highLevelCutoff(*mmap->real);
+    double start = omp_get_wtime();
+    Map* hl = highLevelMap(*mmap->real, mmap->meta->cols, cutoff);
+    double taken = omp_get_wtime() - start;
+    freeMap(hl, true);
+    *work = ((double)params.sidelength) * params.sidelength;
+    return taken;
+}
+
+static double benchBuildMap(MetaMap* mmap, MapParams& params, int seed, double* work) {
+    double start = omp_get_wtime();
+    MetaMap* built = mmap->real->procedural != NULL ?
+        buildProceduralMap(params, seed, mmap->meta->cols) : buildMap(params, seed, mmap->meta->cols);
+    double taken = omp_get_wtime() - start;
+    freeMetaMap(built);
+    *work = ((double)params.sidelength) * params.sidelength;
+    return taken;
+}
+
+static double benchComponents(MetaMap* mmap, MapParams& params, int seed, double* work) {
+    double start = omp_get_wtime();
+    Components* comps = labelComponents(*mmap->real);
+    double taken = omp_get_wtime() - start;
+    freeComponents(comps);
+    *work = ((double)params.sidelength) * params.sidelength;
+    return taken;
+}
+
+//the map keeps the last table built, for the search kernels
+static int landmarkCount = 0;
+
+static double benchLandmarks(MetaMap* mmap, MapParams& params, int seed, double* work) {
+    if (mmap->landmarks != NULL) freeLandmarks(mmap->landmarks);
+    double start = omp_get_wtime();
+    mmap->landmarks = buildLandmarks(*mmap->real, landmarkCount);
+    double taken = omp_get_wtime() - start;
+    *work = ((double)params.sidelength) * params.sidelength;
+    return taken;
+}
+
+static uint64_t expansions() {
+    uint64_t total = 0;
+    for (int t = 0; t < MAX_STAT_THREADS; t++) total += statsTable[t].expanded;
+    return total;
+}
+
+static double benchHlsearch(MetaMap* mmap, MapParams& params, int seed, double* work) {
+    coord start = {1, 1};
+    coord goal = {mmap->real->cols - 2, mmap->real->rows - 2};
+    resetStats();
+    double begin = omp_get_wtime();
+    list<coord>* hlPath = hlsearch(mmap, start, goal);
+    double taken = omp_get_wtime() - begin;
+    delete hlPath;
+    *work = expansions();
+    return taken;
+}
+
+//the fsearch and getPath kernels share the last path found
+static list<NodeId>* lastPath = NULL;
+
+static double benchFsearch(MetaMap* mmap, MapParams& params, int seed, double* work) {
+    Map& real = *mmap->real;
+    coord start = {1, 1};
+    coord goal = {real.cols - 2, real.rows - 2};
+    coord goals[] = {goal};
+    coord otherGoals[] = {start};
+
+    newSearch(real);
+    resetStats();
+    double begin = omp_get_wtime();
+    fs* search = buildFS(mmap, 1, start, goals, 1);
+    //the goal is only recognized once another instance owns it
+    fs* other = buildFS(mmap, 1, goal, otherGoals, 1);
+    while (search->goalsFound < 1) {
+        if (fsearch(search, 2000) == -1) break;
+    }
+    double taken = omp_get_wtime() - begin;
+
+    delete lastPath;
+    lastPath = search->paths[0];
+    freeFS(search);
+    freeFS(other);
+    *work = expansions();
+    return taken;
+}
+
+static double benchGetPath(MetaMap* mmap, MapParams& params, int seed, double* work) {
+    *work = 0;
+    if (lastPath == NULL || lastPath->size() < 2) return 0;
+    //the last cell of a path belongs to the other instance, the one before it leads back to start
+    NodeId end = *(++lastPath->rbegin());
+    double begin = omp_get_wtime();
+    list<NodeId>* path = getPath(*mmap->real, end);
+    double taken = omp_get_wtime() - begin;
+    *work = path->size();
+    delete path;
+    return taken;
+}
+
+static void parseList(const char* arg, vector<int>& into) {
+    into.clear();
+    for (const char* p = arg; *p != '\0'; p++) {
+        into.push_back(atoi(p));
+        while (*p != '\0' && *p != ',') p++;
+        if (*p == '\0') break;
+    }
+}
+
+static void parseList(const char* arg, vector<double>& into) {
+    into.clear();
+    for (const char* p = arg; *p != '\0'; p++) {
+        into.push_back(atof(p));
+        while (*p != '\0' && *p != ',') p++;
+        if (*p == '\0') break;
+    }
+}
+
+//a list of names, each turned into its constant by named
+//false, after saying which, if named doesn't know one of the names
+static bool parseNamed(const char* arg, vector<int>& into, int (*named)(const char*)) {
+    into.clear();
+    for (const char* p = arg; *p != '\0'; p++) {
+        const char* end = strchr(p, ',');
+        if (end == NULL) end = p + strlen(p);
+        string name(p, end - p);
+        int value = named(name.c_str());
+        if (value == -1) {
+            cout << "Unknown name " << name << " in " << arg << endl << flush;
+            return false;
+        }
+        into.push_back(value);
+        p = end;
+        if (*p == '\0') break;
+    }
+    return true;
+}
+
+static void runKernel(FILE* out, BenchConfig& config, const char* name, const char* unit, Kernel kernel,
+                      MetaMap* mmap, MapParams& params, int seed) {
+    double work = 0;
+    for (int w = 0; w < config.warmup; w++) {
+        kernel(mmap, params, seed, &work);
+    }
+    vector<double> times;
+    double totalWork = 0;
+    double totalMisses = 0;
+    for (int r = 0; r < config.reps; r++) {
+        switchTlbCounter(tlbCounter, true);
+        times.push_back(kernel(mmap, params, seed, &work));
+        switchTlbCounter(tlbCounter, false);
+        totalWork += work;
+        totalMisses += readTlbCounter(tlbCounter);
+    }
+    double meanWork = totalWork / config.reps;
+    Timing t = summarize(times);
+    fprintf(out, "%s,%d,%g,%d,%d,%d,%s,%d,%s,%s,%s,%s,%d,%.9f,%.9f,%.9f,%.9f,%.9f,%.0f,%s,%.6g,%g,%.0f\n",
+        name, params.sidelength, params.obsratio, mmap->meta->cols, seed, omp_get_max_threads(),
+        mmap->expansion == EXPAND_JUMP ? "jps" : "all", mmap->landmarks != NULL ? mmap->landmarks->count : 0,
+        layoutName(mmap->real->layout), mmap->real->stateMode == STATE_PAGED ? "paged" : "dense",
+        mmap->real->procedural != NULL ? "procedural" : "filled", pageModeName(pageMode()),
+        config.reps, t.mean, t.stddev, t.min, t.median, t.max,
+        meanWork, unit, t.mean > 0 ? meanWork / t.mean : 0, bytesPerNode(*mmap->real),
+        tlbCounter.fds.empty() ? -1 : totalMisses / config.reps);
+    fflush(out);
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    config.sizes.push_back(1024);
+    config.sizes.push_back(2048);
+    config.ratios.push_back(.2);
+    config.hlSides.push_back(16);
+    config.seeds.push_back(1);
+    config.warmup = 1;
+    config.reps = 5;
+    FILE* out = stdout;
+    //all sweeps are comma separated lists
+    config.expansion = EXPAND_ALL;
+    config.landmarks = 0;
+    config.layouts.push_back(LAYOUT_PLAIN);
+    config.stateMode = STATE_DENSE;
+    config.procedural = false;
+    config.pageModes.push_back(PAGES_SMALL);
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "--jps") == 0) {
+            config.expansion = EXPAND_JUMP;
+            continue;
+        }
+        if (strcmp(argv[arg], "--paged") == 0) {
+            config.stateMode = STATE_PAGED;
+            continue;
+        }
+        if (strcmp(argv[arg], "--procedural") == 0) {
+            config.procedural = true;
+            continue;
+        }
+        if (arg+1 >= argc) {
+            cout << "Missing value for " << argv[arg] << endl << flush;
+            return 0;
+        }
+        if (strcmp(argv[arg], "--sizes") == 0) parseList(argv[++arg], config.sizes);
+        else if (strcmp(argv[arg], "--ratios") == 0) parseList(argv[++arg], config.ratios);
+        else if (strcmp(argv[arg], "--hl") == 0) parseList(argv[++arg], config.hlSides);
+        else if (strcmp(argv[arg], "--seeds") == 0) parseList(argv[++arg], config.seeds);
+        else if (strcmp(argv[arg], "--layouts") == 0) {
+            if (!parseNamed(argv[++arg], config.layouts, layoutNamed)) return 1;
+        }
+        else if (strcmp(argv[arg], "--pages") == 0) {
+            if (!parseNamed(argv[++arg], config.pageModes, pageModeNamed)) return 1;
+        }
+        else if (strcmp(argv[arg], "--alt") == 0) config.landmarks = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "--warmup") == 0) config.warmup = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "--reps") == 0) config.reps = max(1, atoi(argv[++arg]));
+        else if (strcmp(argv[arg], "--out") == 0) {
+            out = fopen(argv[++arg], "w");
+            if (out == NULL) {
+                cout << "Couldn't open " << argv[arg] << endl << flush;
+                return 0;
+            }
+        }
+        else {
+            cout << "usage: bench [--sizes a,b] [--ratios a,b] [--hl a,b] [--seeds a,b] "
+                "[--warmup n] [--reps n] [--out file] [--jps] [--alt k] "
+                "[--layouts plain,padded,morton] [--paged] [--procedural] [--pages small,thp,hugetlb]" << endl << flush;
+            return 0;
+        }
+    }
+    if (!statsEnabled) {
+        cerr << "Built with PRS_STATS=0, search kernels will report no expansions" << endl;
+    }
+
+    tlbCounter = openTlbCounter();
+    if (tlbCounter.fds.empty()) {
+        cerr << "perf can't count data TLB misses here, dtlb_misses will be -1" << endl;
+    }
+
+    fprintf(out, "kernel,side,ratio,hl_side,seed,threads,expansion,landmarks,layout,state,obstacles,pages,reps,mean_s,stddev_s,min_s,median_s,max_s,"
+        "work,work_unit,work_per_s,bytes_per_node,dtlb_misses\n");
+    for (size_t si = 0; si < config.sizes.size(); si++)
+    for (size_t ri = 0; ri < config.ratios.size(); ri++)
+    for (size_t hi = 0; hi < config.hlSides.size(); hi++)
+    for (size_t ei = 0; ei < config.seeds.size(); ei++)
+    for (size_t li = 0; li < config.layouts.size(); li++)
+    for (size_t pi = 0; pi < config.pageModes.size(); pi++) {
+        setPageMode(config.pageModes[pi]);
+        int side = config.sizes[si];
+        int seed = config.seeds[ei];
+        MapParams params = {
+            side,
+            config.ratios[ri],
+            config.ratios[ri] / log2(1.0 * side),
+            config.layouts[li],
+            config.stateMode
+        };
+        MetaMap* mmap = config.procedural ?
+            buildProceduralMap(params, seed, config.hlSides[hi]) : buildMap(params, seed, config.hlSides[hi]);
+        mmap->expansion = config.expansion;
+
+        //same corners as prs
+        Map& real = *mmap->real;
+        coord start = {1, 1};
+        coord goal = {side - 2, side - 2};
+        coord hlStart = bigToLittle(mmap, start);
+        coord hlGoal = bigToLittle(mmap, goal);
+        setBlocked(real, getNode(real, start.x, start.y), 0);
+        setBlocked(real, getNode(real, goal.x, goal.y), 0);
+        setBlocked(*mmap->meta, getNode(mmap->meta, hlStart.x, hlStart.y), 0);
+        setBlocked(*mmap->meta, getNode(mmap->meta, hlGoal.x, hlGoal.y), 0);
+
+        runKernel(out, config, "obsFiller", "cells", benchObsFiller, mmap, params, seed);
+        runKernel(out, config, "highLevelMap", "cells", benchHighLevelMap, mmap, params, seed);
+        runKernel(out, config, "buildMap", "cells", benchBuildMap, mmap, params, seed);
+        runKernel(out, config, "components", "cells", benchComponents, mmap, params, seed);
+        landmarkCount = config.landmarks;
+        if (landmarkCount > 0) {
+            runKernel(out, config, "landmarks", "cells", benchLandmarks, mmap, params, seed);
+        }
+        runKernel(out, config, "hlsearch", "expansions", benchHlsearch, mmap, params, seed);
+        runKernel(out, config, "fsearch", "expansions", benchFsearch, mmap, params, seed);
+        if (lastPath != NULL) {
+            runKernel(out, config, "getPath", "cells", benchGetPath, mmap, params, seed);
+        }
+        else {
+            cerr << "No corner to corner path for side " << side << " seed " << seed << ", skipping getPath" << endl;
+        }
+
+        delete lastPath;
+        lastPath = NULL;
+        if (mmap->landmarks != NULL) freeLandmarks(mmap->landmarks);
+        freeMetaMap(mmap);
+    }
+    if (out != stdout) fclose(out);
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include <stdlib.h>
+
+#include <vector>
+
+#include "components.h"
+
+using namespace std;
+
+//parents are read and rewritten by other threads while flattening, and any ancestor
+// they see is as good as another
+static NodeId loadParent(NodeId* parent, NodeId node) {
+	return __atomic_load_n(&(parent[node]), __ATOMIC_RELAXED);
+}
+static void storeParent(NodeId* parent, NodeId node, NodeId to) {
+	__atomic_store_n(&(parent[node]), to, __ATOMIC_RELAXED);
+}
+
+static NodeId findRoot(NodeId* parent, NodeId node) {
+	NodeId up = loadParent(parent, node);
+	while (up != node) {
+		node = up;
+		up = loadParent(parent, node);
+	}
+	return node;
+}
+
+//the root with the lower index wins, so a component's root is its first cell
+static void unite(NodeId* parent, NodeId a, NodeId b) {
+	NodeId ra = findRoot(parent, a);
+	NodeId rb = findRoot(parent, b);
+	if (ra < rb) storeParent(parent, rb, ra);
+	else if (rb < ra) storeParent(parent, ra, rb);
+}
+
+static void storeLabel(Components* comps, NodeId node, uint64_t label) {
+	uint64_t offset = ((uint64_t)node) * comps->bits;
+	int shift = offset & 63;
+	comps->labels[offset >> 6] |= label << shift;
+	if (shift + comps->bits > 64) comps->labels[(offset >> 6) + 1] |= label >> (64 - shift);
+}
+
+Components* labelComponents(Map& map) {
+	NodeId cells = map.cells;
+	NodeId* parent = (NodeId*) malloc(cells * sizeof(NodeId));
+	vector<int64_t> rootsBefore(omp_get_max_threads() + 1, 0);
+	Components* comps = (Components*) malloc(sizeof(Components));
+
+	#pragma omp parallel
+	{
+		int threads = omp_get_num_threads();
+		int t = omp_get_thread_num();
+		int lo = (int)(((int64_t)map.rows) * t / threads);
+		int hi = (int)(((int64_t)map.rows) * (t + 1) / threads);
+		//each strip on its own: every link stays inside it. Strips are walked by coordinate,
+		// their cells needn't be contiguous ids
+		for (int x = lo; x < hi; x++) {
+			for (int y = 0; y < map.cols; y++) {
+				NodeId n = indexOf(map, x, y);
+				parent[n] = n;
+				if (isBlocked(map, n)) continue;
+				NodeId up = neighborOf(map, n, DIR_XMINUS);
+				NodeId left = neighborOf(map, n, DIR_YMINUS);
+				if (x > lo && !isBlocked(map, up)) unite(parent, n, up);
+				if (y > 0 && !isBlocked(map, left)) unite(parent, n, left);
+			}
+		}
+		#pragma omp barrier
+		#pragma omp single
+		for (int s = 1; s < threads; s++) {
+			int x = (int)(((int64_t)map.rows) * s / threads);
+			if (x == 0) continue;
+			for (int y = 0; y < map.cols; y++) {
+				NodeId n = indexOf(map, x, y);
+				NodeId up = neighborOf(map, n, DIR_XMINUS);
+				if (!isBlocked(map, n) && !isBlocked(map, up)) unite(parent, n, up);
+			}
+		}
+
+		//point every cell straight at its root, and count the roots of the strip
+		int64_t roots = 0;
+		for (int x = lo; x < hi; x++) {
+			for (int y = 0; y < map.cols; y++) {
+				NodeId n = indexOf(map, x, y);
+				if (isBlocked(map, n)) continue;
+				NodeId root = findRoot(parent, n);
+				storeParent(parent, n, root);
+				if (root == n) roots++;
+			}
+		}
+		rootsBefore[t + 1] = roots;
+		#pragma omp barrier
+		#pragma omp single
+		{
+			for (int s = 0; s < threads; s++) rootsBefore[s + 1] += rootsBefore[s];
+			comps->count = rootsBefore[threads];
+			comps->bits = 1;
+			while ((comps->count >> comps->bits) != 0) comps->bits++;
+			//one spare word, so reading a label never needs a bounds check
+			uint64_t words = (((uint64_t)cells) * comps->bits + 63) / 64 + 1;
+			comps->labels = (uint64_t*) calloc(words, sizeof(uint64_t));
+		}
+
+		//roots trade their parent for their label, as -label. Strips number their roots in
+		// order, so labels don't depend on the thread count
+		int64_t label = rootsBefore[t];
+		for (int x = lo; x < hi; x++) {
+			for (int y = 0; y < map.cols; y++) {
+				NodeId n = indexOf(map, x, y);
+				if (!isBlocked(map, n) && parent[n] == n) parent[n] = -(++label);
+			}
+		}
+		#pragma omp barrier
+
+		//64 cells take a whole number of words whatever the label width, so no two
+		// threads write to the same word
+		#pragma omp for schedule(static)
+		for (NodeId block = 0; block < (cells + 63) / 64; block++) {
+			for (NodeId n = block * 64; n < cells && n < block * 64 + 64; n++) {
+				if (isBlocked(map, n)) continue;
+				NodeId up = parent[n];
+				storeLabel(comps, n, up < 0 ? -up : -parent[up]);
+			}
+		}
+	}
+	free(parent);
+	return comps;
+}
+
+void freeComponents(Components* comps) {
+	free(comps->labels);
+	free(comps);
+}
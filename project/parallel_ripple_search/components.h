@@ -0,0 +1,38 @@
+#include <stdint.h>
+
+#include "nodemap.h"
+
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+//connected components of the free cells of a map, so a query between cells that can't
+// reach each other is turned down before any search starts. Labels are numbered 1..count
+// (0 for obstacles) and bit packed, each taking just enough bits for count, so on most
+// maps they cost a fraction of the state words.
+//The labels are only valid for the obstacles they were computed from: unblocking a cell
+// afterwards can join components they keep apart
+struct Components {
+	uint64_t* labels;
+	int bits;      //per label
+	int64_t count; //of components
+};
+
+//union-find over strips of rows, one per thread, joined along the strip borders
+Components* labelComponents(Map& map);
+void freeComponents(Components* comps);
+
+inline int64_t componentOf(Components* comps, NodeId node) {
+	uint64_t offset = ((uint64_t)node) * comps->bits;
+	int shift = offset & 63;
+	uint64_t value = comps->labels[offset >> 6] >> shift;
+	if (shift + comps->bits > 64) value |= comps->labels[(offset >> 6) + 1] << (64 - shift);
+	return value & ((((uint64_t)1) << comps->bits) - 1);
+}
+
+//false if either cell is an obstacle
+inline bool connected(Components* comps, NodeId a, NodeId b) {
+	int64_t label = componentOf(comps, a);
+	return label != 0 && label == componentOf(comps, b);
+}
+
+#endif
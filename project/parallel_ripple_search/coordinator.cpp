@@ -0,0 +1,225 @@
+#include <stdlib.h>
+#include <time.h>
+
+#include "coordinator.h"
+#include "stats.h"
+
+Coordinator* buildCoordinator(fs** segments, int slaves) {
+	Coordinator* coord = (Coordinator*)malloc(sizeof(Coordinator));
+	coord->status = (SlaveStatus*)aligned_alloc(CACHE_LINE, slaves * sizeof(SlaveStatus));
+	for (int i = 0; i < slaves; i++) {
+		coord->status[i].state = SLAVE_SEARCHING;
+		coord->status[i].running = segments[i];
+		coord->status[i].thief = 0;
+		coord->status[i].answered = 0;
+		coord->status[i].gift = NULL;
+	}
+	coord->segments = segments;
+	coord->slaves = slaves;
+	coord->remaining = slaves;
+	coord->failed = 0;
+	pthread_mutex_init(&(coord->mutex), NULL);
+	pthread_cond_init(&(coord->changed), NULL);
+	return coord;
+}
+
+void freeCoordinator(Coordinator* coord) {
+	pthread_mutex_destroy(&(coord->mutex));
+	pthread_cond_destroy(&(coord->changed));
+	free(coord->status);
+	free(coord);
+}
+
+static void broadcast(Coordinator* coord) {
+	pthread_mutex_lock(&(coord->mutex));
+	pthread_cond_broadcast(&(coord->changed));
+	pthread_mutex_unlock(&(coord->mutex));
+}
+
+//called by whichever team member sees its segment finish or fail. Only the first report
+// for a segment counts
+void publishStatus(Coordinator* coord, fs* team, int state) {
+	int slave = 0;
+	while (coord->segments[slave] != team) slave++;
+
+	int expected = SLAVE_SEARCHING;
+	if (!__atomic_compare_exchange_n(&(coord->status[slave].state), &expected, state, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		return;
+	}
+	if (state == SLAVE_FAILED) {
+		__atomic_store_n(&(coord->failed), 1, __ATOMIC_RELEASE);
+	}
+	int left = __atomic_sub_fetch(&(coord->remaining), 1, __ATOMIC_ACQ_REL);
+	if (left == 0 || state == SLAVE_FAILED) {
+		broadcast(coord);
+	}
+}
+
+int statusOf(Coordinator* coord, int slave) {
+	return __atomic_load_n(&(coord->status[slave].state), __ATOMIC_ACQUIRE);
+}
+
+//true once every segment has finished, or as soon as one has failed
+bool searchOver(Coordinator* coord) {
+	return __atomic_load_n(&(coord->remaining), __ATOMIC_ACQUIRE) == 0 ||
+	       __atomic_load_n(&(coord->failed), __ATOMIC_ACQUIRE);
+}
+
+void setRunning(Coordinator* coord, int me, fs* running) {
+	__atomic_store_n(&(coord->status[me].running), running, __ATOMIC_RELEASE);
+}
+
+//called by a busy thread between fsearch batches, and by idle threads with running == NULL.
+// If another thread asked for work, hands it half of running's fringe (or declines)
+void answerSteal(Coordinator* coord, int me, fs* running) {
+	if (__atomic_load_n(&(coord->status[me].thief), __ATOMIC_ACQUIRE) == 0) return;
+
+	fs* gift = running == NULL ? NULL : splitFS(running);
+	pthread_mutex_lock(&(coord->mutex));
+	int thief = coord->status[me].thief - 1;
+	coord->status[thief].gift = gift;
+	coord->status[thief].answered = 1;
+	coord->status[me].thief = 0;
+	pthread_cond_broadcast(&(coord->changed));
+	pthread_mutex_unlock(&(coord->mutex));
+}
+
+//fringe size of what a thread is running, only a hint since its owner keeps changing it
+static int workOf(Coordinator* coord, int slave) {
+	fs* running = __atomic_load_n(&(coord->status[slave].running), __ATOMIC_ACQUIRE);
+	if (running == NULL || teamFinished(running)) return 0;
+	return running->now.size + running->later.size;
+}
+
+static void waitAMoment(Coordinator* coord) {
+	if (statsEnabled) threadStats()->idleWaits++;
+	struct timespec until;
+	clock_gettime(CLOCK_REALTIME, &until);
+	until.tv_nsec += 1000000;
+	if (until.tv_nsec >= 1000000000) {
+		until.tv_sec++;
+		until.tv_nsec -= 1000000000;
+	}
+	pthread_cond_timedwait(&(coord->changed), &(coord->mutex), &until);
+}
+
+static fs* lookForWork(Coordinator* coord, int me) {
+	setRunning(coord, me, NULL);
+	pthread_mutex_lock(&(coord->mutex));
+	while (!searchOver(coord)) {
+		//nobody should wait on an idle thread
+		if (coord->status[me].thief != 0) {
+			pthread_mutex_unlock(&(coord->mutex));
+			answerSteal(coord, me, NULL);
+			pthread_mutex_lock(&(coord->mutex));
+			continue;
+		}
+
+		int victim = -1;
+		int most = 0;
+		for (int s = 0; s < coord->slaves; s++) {
+			if (s == me || coord->status[s].thief != 0) continue;
+			int work = workOf(coord, s);
+			if (work > most) {
+				most = work;
+				victim = s;
+			}
+		}
+		if (victim == -1) {
+			waitAMoment(coord);
+			continue;
+		}
+
+		coord->status[victim].thief = me + 1;
+		coord->status[me].answered = 0;
+		while (!coord->status[me].answered && !searchOver(coord)) {
+			if (coord->status[me].thief != 0) {
+				pthread_mutex_unlock(&(coord->mutex));
+				answerSteal(coord, me, NULL);
+				pthread_mutex_lock(&(coord->mutex));
+				continue;
+			}
+			waitAMoment(coord);
+		}
+		if (coord->status[me].answered && coord->status[me].gift != NULL) {
+			fs* gift = coord->status[me].gift;
+			coord->status[me].gift = NULL;
+			pthread_mutex_unlock(&(coord->mutex));
+			setRunning(coord, me, gift);
+			return gift;
+		}
+		//declined, maybe the victim finished meanwhile; look again
+		if (!searchOver(coord)) waitAMoment(coord);
+	}
+	pthread_mutex_unlock(&(coord->mutex));
+	return NULL;
+}
+
+//called by a thread with nothing left to search. Asks the thread with the largest fringe
+// for part of it and blocks until it gets a helper instance, or returns NULL once the
+// search is over
+fs* stealWork(Coordinator* coord, int me) {
+	uint64_t idleStart = statsEnabled ? statsClockNs() : 0;
+	fs* gift = lookForWork(coord, me);
+	if (statsEnabled) {
+		ThreadStats* stats = threadStats();
+		stats->idleNs += statsClockNs() - idleStart;
+		if (gift != NULL) stats->steals++;
+	}
+	return gift;
+}
+
+//frees a helper its thread has stopped running. Other threads only look at running
+// instances under the mutex (see workOf), so once the thread has published that it runs
+// nothing and taken the mutex once, nobody can still hold the helper
+static void releaseHelper(Coordinator* coord, int me, fs* helper) {
+	setRunning(coord, me, NULL);
+	pthread_mutex_lock(&(coord->mutex));
+	pthread_mutex_unlock(&(coord->mutex));
+	freeFS(helper);
+}
+
+//thread id's part of the search: segment id, then whatever it can steal
+static void runSlave(Coordinator* coord, int id) {
+	fs* mySearch = coord->segments[id];
+
+	//search until the current instance's team has met all of its neighbors, then
+	// publish that directly; nobody has to acknowledge it. After that (or once the
+	// current instance runs dry) steal part of a busy thread's fringe
+	while (mySearch != NULL) {
+		int retStatus = fsearch(mySearch, 2000);
+		fs* team = mySearch->team;
+		if (teamFinished(mySearch)) {
+			publishStatus(coord, team, SLAVE_FINISHED);
+		}
+		else if (retStatus == -1) {
+			//the segment only fails once every member of its team is out of nodes
+			if (__atomic_sub_fetch(&(team->active), 1, __ATOMIC_ACQ_REL) == 0) {
+				publishStatus(coord, team, SLAVE_FAILED);
+			}
+		}
+		else if (!searchOver(coord)) {
+			answerSteal(coord, id, mySearch);
+			continue;
+		}
+		answerSteal(coord, id, NULL);
+		if (mySearch != coord->segments[id]) releaseHelper(coord, id, mySearch);
+		mySearch = stealWork(coord, id);
+	}
+}
+
+//runs the search: thread i starts on segment i, and every thread keeps searching or
+// helping until each segment has finished or one has failed. Every segment needs a
+// thread of its own, since its neighbors wait on it, so if omp hands out fewer threads
+// than there are segments nothing is searched and false is returned
+bool searchSegments(Coordinator* coord) {
+	int threads = 0;
+	#pragma omp parallel num_threads(coord->slaves) // this is where the magic happens
+	{
+		//the implicit barrier at its end keeps everyone from reading threads too early
+		#pragma omp single
+		threads = omp_get_num_threads();
+		if (threads == coord->slaves) runSlave(coord, omp_get_thread_num());
+	}
+	return threads == coord->slaves;
+}
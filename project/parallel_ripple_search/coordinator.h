@@ -0,0 +1,53 @@
+#include <pthread.h>
+
+#include "fringesearch.h"
+
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+
+#define CACHE_LINE 64
+
+//what a slave last published about its search instance
+#define SLAVE_SEARCHING 0
+#define SLAVE_FINISHED  1 //found paths to all of its goals
+#define SLAVE_FAILED    2 //ran out of nodes before finding all of its goals
+
+//one per thread. Slave i starts out running segment i, so the same slot also carries the
+// status of segment i. Each slot gets a cache line to itself so that threads polling their
+// own slot don't invalidate each other
+struct SlaveStatus {
+	int state;    //SLAVE_* of the segment this slot belongs to
+	fs* running;  //instance the thread is currently searching, NULL while idle
+	int thief;    //1 + id of a thread asking this one for work, 0 if nobody is
+	int answered; //set when a victim has replied to this thread's request
+	fs* gift;     //the reply: a helper instance to search, or NULL if it declined
+} __attribute__((aligned(CACHE_LINE)));
+
+//replaces the master thread: slaves publish their own completion, the last one to
+// finish wakes everyone. Threads whose segment is done steal part of a busy thread's
+// fringe instead of sitting idle
+struct Coordinator {
+	SlaveStatus* status;
+	fs** segments; //segments[i] is the instance built for slave i
+	int slaves;
+	int remaining; //segments still searching
+	int failed;    //set once any segment fails, the stitched path can't exist after that
+	pthread_mutex_t mutex;
+	pthread_cond_t changed; //broadcast whenever a search ends or a steal request is answered
+};
+
+Coordinator* buildCoordinator(fs** segments, int slaves);
+void freeCoordinator(Coordinator* coord);
+
+void publishStatus(Coordinator* coord, fs* team, int state);
+int statusOf(Coordinator* coord, int slave);
+
+bool searchOver(Coordinator* coord);
+
+void setRunning(Coordinator* coord, int me, fs* running);
+void answerSteal(Coordinator* coord, int me, fs* running);
+fs* stealWork(Coordinator* coord, int me);
+
+bool searchSegments(Coordinator* coord);
+
+#endif
@@ -0,0 +1,220 @@
+#include "engine.h"
+#include "ripple.h"
+#include "tiledfile.h"
+
+#include <string.h>
+
+//how many iterations each segment gets before the worker moves on to the next one
+#define SEGMENT_BATCH 2000
+
+//a map sharing map's obstacles, read only, with state of its own. Real map views keep
+// their state in pages (see STATE_PAGED), so a worker only holds what its current query
+// explores; a high level map is small enough to give every view all of its words
+static Map* viewOf(Map* map, int stateMode) {
+	Map* view = allocateMapUnfilled(map->cols, map->percchange, map->layout, stateMode);
+	view->rows = map->rows;
+	view->blocked = map->blocked;
+	view->procedural = map->procedural;
+	view->tiles = map->tiles;
+	return view;
+}
+
+Engine* buildEngine(MetaMap* mmap, int workers, int segments) {
+	Engine* engine = (Engine*) malloc(sizeof(Engine));
+	engine->shared = mmap;
+	engine->workers = workers;
+	engine->segments = segments < 2 ? 2 : segments;
+	engine->components = labelComponents(*mmap->real);
+	engine->subgoals = NULL;
+	engine->subgoalSearches = NULL;
+	engine->views = (MetaMap**) malloc(workers * sizeof(MetaMap*));
+	for (int w = 0; w < workers; w++) {
+		MetaMap* view = assembleMetaMap(viewOf(mmap->real, STATE_PAGED), viewOf(mmap->meta, STATE_DENSE));
+		view->factor = mmap->factor;
+		view->claimMode = mmap->claimMode;
+		view->expansion = mmap->expansion;
+		view->landmarks = mmap->landmarks;
+		engine->views[w] = view;
+	}
+	return engine;
+}
+
+void attachSubgoals(Engine* engine, SubgoalGraph* graph) {
+	engine->subgoals = graph;
+	engine->subgoalSearches = (SubgoalSearch**) malloc(engine->workers * sizeof(SubgoalSearch*));
+	for (int w = 0; w < engine->workers; w++) {
+		engine->subgoalSearches[w] = buildSubgoalSearch(graph);
+	}
+}
+
+void freeEngine(Engine* engine) {
+	if (engine->subgoals != NULL) {
+		for (int w = 0; w < engine->workers; w++) {
+			freeSubgoalSearch(engine->subgoalSearches[w]);
+		}
+		free(engine->subgoalSearches);
+	}
+	for (int w = 0; w < engine->workers; w++) {
+		MetaMap* view = engine->views[w];
+		int numLocks = view->meta->rows * view->meta->cols;
+		for (int i = 0; i < numLocks; i++) {
+			omp_destroy_lock(&(view->locks[i]));
+		}
+		delete[] view->locks;
+		freeMap(view->real, false);
+		freeMap(view->meta, false);
+		free(view);
+	}
+	free(engine->views);
+	freeComponents(engine->components);
+	free(engine);
+}
+
+const char* queryStatusName(int status) {
+	switch (status) {
+		case QUERY_OK: return "ok";
+		case QUERY_BLOCKED: return "blocked";
+		case QUERY_NO_HL: return "no_hl_path";
+		case QUERY_FAILED: return "failed";
+		case QUERY_UNREACHABLE: return "unreachable";
+	}
+	return "unknown";
+}
+
+static bool onMap(Map& map, coord c) {
+	return validX(map, c.x) && validY(map, c.y);
+}
+
+//runs every segment on the calling thread, a batch at a time, until all of them have met
+// their neighbors or one of them runs dry
+static bool runSegments(fs** segments, int count) {
+	int finished = 0;
+	while (finished < count) {
+		finished = 0;
+		for (int c = 0; c < count; c++) {
+			if (teamFinished(segments[c])) {
+				finished++;
+				continue;
+			}
+			if (fsearch(segments[c], SEGMENT_BATCH) == -1 && !teamFinished(segments[c])) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static int searchWith(MetaMap* mmap, coord* points, int count, list<coord>** path) {
+	newSearch(*mmap->real);
+	fs** segments = buildSegments(mmap, points, count);
+
+	int status = QUERY_FAILED;
+	if (runSegments(segments, count)) {
+		*path = stitchPath(mmap, segments, count);
+		status = pathIntact(*path) ? QUERY_OK : QUERY_FAILED;
+		if (status != QUERY_OK) {
+			delete *path;
+			*path = NULL;
+		}
+	}
+
+	for (int c = 0; c < count; c++) {
+		delete[] segments[c]->goals;
+		for (int g = 0; g < segments[c]->numGoals; g++) {
+			delete segments[c]->paths[g];
+		}
+		freeFS(segments[c]);
+	}
+	delete[] segments;
+	return status;
+}
+
+int runQuery(Engine* engine, int worker, coord start, coord goal, list<coord>** path) {
+	MetaMap* mmap = engine->views[worker];
+	Map& real = *mmap->real;
+	Map& meta = *mmap->meta;
+	*path = NULL;
+
+	if (!onMap(real, start) || !onMap(real, goal) ||
+		isBlocked(real, start.x, start.y) || isBlocked(real, goal.x, goal.y)) {
+		return QUERY_BLOCKED;
+	}
+	NodeId startNode = getNode(real, start.x, start.y);
+	if (!connected(engine->components, startNode, getNode(real, goal.x, goal.y))) {
+		return QUERY_UNREACHABLE;
+	}
+	if (start == goal) {
+		*path = new list<coord>(1, start);
+		return QUERY_OK;
+	}
+	if (engine->subgoals != NULL) {
+		*path = subgoalQuery(real, engine->subgoalSearches[worker], start, goal);
+		if (*path != NULL) return QUERY_OK;
+	}
+
+	//the squares holding start and goal have to be passable for the high level search. The
+	// high level bitset is shared by every worker, so a query that has to open either
+	// searches a copy of it, which is only hlside^2 bits
+	coord hlStart = bigToLittle(mmap, start);
+	coord hlGoal = bigToLittle(mmap, goal);
+	NodeId hlStartNode = getNode(meta, hlStart.x, hlStart.y);
+	NodeId hlGoalNode = getNode(meta, hlGoal.x, hlGoal.y);
+	uint64_t* sharedMeta = meta.blocked;
+	uint64_t* opened = NULL;
+	if (isBlocked(meta, hlStartNode) || isBlocked(meta, hlGoalNode)) {
+		opened = (uint64_t*) malloc(bitsetWords(meta) * sizeof(uint64_t));
+		memcpy(opened, sharedMeta, bitsetWords(meta) * sizeof(uint64_t));
+		meta.blocked = opened;
+		setBlocked(meta, hlStartNode, 0);
+		setBlocked(meta, hlGoalNode, 0);
+	}
+
+	list<coord>* hlPath = hlsearch(mmap, start, goal);
+
+	if (opened != NULL) {
+		meta.blocked = sharedMeta;
+		free(opened);
+	}
+
+	//the components already say start and goal are connected, only the coarse squares
+	// between them looked blocked. Search the real map with just the two end segments
+	if (hlPath == NULL) {
+		coord ends[2] = {start, goal};
+		int status = searchWith(mmap, ends, 2, path);
+		return status == QUERY_FAILED ? QUERY_NO_HL : status;
+	}
+
+	//the obstacles the segments are about to search through, ahead of them
+	prefetchPath(mmap, hlPath);
+
+	//no more segments than high level squares to start them in
+	int count = engine->segments;
+	coord* points = placeSegments(mmap, hlPath, &count);
+	points[0] = start;
+	points[count-1] = goal;
+	for (int c = 1; c < count-1; c++) {
+		points[c] = openCellIn(mmap, points[c]);
+	}
+	delete hlPath;
+
+	//segments are told apart by their start, so neighbors can't share one. A start in a
+	// pocket cut off from the query's component would only search the pocket
+	int kept = 1;
+	for (int c = 1; c < count; c++) {
+		if (points[c] == points[kept-1]) continue;
+		if (!connected(engine->components, startNode, getNode(real, points[c].x, points[c].y))) continue;
+		points[kept++] = points[c];
+	}
+	count = kept;
+
+	//the cells claimed by an intermediate segment can still wall its neighbors off from
+	// each other, so before giving up search again with only the start and goal segments
+	int status = searchWith(mmap, points, count, path);
+	if (status == QUERY_FAILED && count > 2) {
+		points[1] = goal;
+		status = searchWith(mmap, points, 2, path);
+	}
+
+	delete[] points;
+	return status;
+}
@@ -0,0 +1,49 @@
+#include "nodemap.h"
+#include "fringesearch.h"
+#include "subgoal.h"
+#include "components.h"
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <list>
+
+using namespace std;
+
+//runQuery results
+#define QUERY_OK       0
+#define QUERY_BLOCKED  1 //start or goal is an obstacle, or off the map
+#define QUERY_NO_HL    2 //the high level search found no path, and neither did the start
+                          // and goal segments searching without it
+#define QUERY_FAILED   3 //a segment ran out of nodes before meeting its neighbors
+#define QUERY_UNREACHABLE 4 //start and goal are in different components of the real map
+
+//every worker searches in its own view of the shared map: the views share the obstacles
+// of the real and high level maps, read only, but each has its own state, owners and
+// locks, so queries on different workers never see each other's search state. A view's
+// real state is paged, so a worker holds what its current query explored rather than a
+// word for every cell
+struct Engine {
+	MetaMap* shared;
+	MetaMap** views; //one per worker
+	int workers;
+	int segments; //ripple segments per query (>=2), run round robin by the query's worker
+	Components* components; //of the real map, labelled when the engine is built
+
+	//optional, see attachSubgoals
+	SubgoalGraph* subgoals;
+	SubgoalSearch** subgoalSearches; //one per worker
+};
+
+Engine* buildEngine(MetaMap* mmap, int workers, int segments);
+void freeEngine(Engine* engine);
+//answer queries from the subgoal graph first, only searching the grid for the ones it
+// can't connect. The engine doesn't take ownership of the graph
+void attachSubgoals(Engine* engine, SubgoalGraph* graph);
+
+//the path is only set for QUERY_OK, and belongs to the caller
+int runQuery(Engine* engine, int worker, coord start, coord goal, list<coord>** path);
+
+const char* queryStatusName(int status);
+
+#endif
@@ -4,8 +4,12 @@
 #include <stdint.h>
 
 #include <iostream>
+#include <algorithm>
 
 #include "fringesearch.h"
+#include "stats.h"
+#include "landmarks.h"
+#include "arena.h"
 
 using namespace std;
 
@@ -17,6 +21,125 @@ int manhattan(coord a, coord b) {
 	return manhattan(a.x, a.y, b.x, b.y);
 }
 
+//how the kernels estimate the cost to a goal
+#define HEURISTIC_MANHATTAN 0
+#define HEURISTIC_ALT       1
+
+//admissible estimate of the cost from n to goal: manhattan distance, or what the
+// landmarks give if that's more. The kernels know which it is when they're compiled
+template <int HEURISTIC>
+static inline int estimateWith(MetaMap* mmap, NodeId n, coord nc, coord goal) {
+	int h = manhattan(nc, goal);
+	if (HEURISTIC == HEURISTIC_ALT) {
+		int bound = landmarkBound(mmap->landmarks, n, getNode(*mmap->real, goal.x, goal.y));
+		if (bound > h) h = bound;
+	}
+	return h;
+}
+
+static int estimate(MetaMap* mmap, NodeId n, coord nc, coord goal) {
+	if (mmap->landmarks != NULL) return estimateWith<HEURISTIC_ALT>(mmap, n, nc, goal);
+	return estimateWith<HEURISTIC_MANHATTAN>(mmap, n, nc, goal);
+}
+
+#define INITIAL_FRINGE_SLOTS 1024
+
+//the ids of a fresh instance's lists
+#define NOW_LIST   0
+#define LATER_LIST 1
+
+static void initFringeList(FringeList& list, int id) {
+	list.head = -1;
+	list.tail = -1;
+	list.size = 0;
+	list.id = id;
+}
+
+static void initFringePool(FringePool& pool) {
+	pool.capacity = INITIAL_FRINGE_SLOTS;
+	pool.node = (NodeId*)malloc(pool.capacity * sizeof(NodeId));
+	pool.next = (int*)malloc(pool.capacity * sizeof(int));
+	pool.prev = (int*)malloc(pool.capacity * sizeof(int));
+	pool.list = (unsigned char*)malloc(pool.capacity * sizeof(unsigned char));
+	for (int i = 0; i < pool.capacity; i++) {
+		pool.node[i] = NO_NODE;
+		pool.next[i] = i+1 < pool.capacity ? i+1 : -1;
+	}
+	pool.freeHead = 0;
+}
+
+static int allocSlot(FringePool& pool) {
+	if (pool.freeHead == -1) {
+		int old = pool.capacity;
+		pool.capacity *= 2;
+		//pools big enough to span huge pages move onto them (see arena.h)
+		pool.node = (NodeId*)arenaRealloc(pool.node, old * sizeof(NodeId), pool.capacity * sizeof(NodeId));
+		pool.next = (int*)arenaRealloc(pool.next, old * sizeof(int), pool.capacity * sizeof(int));
+		pool.prev = (int*)arenaRealloc(pool.prev, old * sizeof(int), pool.capacity * sizeof(int));
+		pool.list = (unsigned char*)arenaRealloc(pool.list, old * sizeof(unsigned char), pool.capacity * sizeof(unsigned char));
+		for (int i = old; i < pool.capacity; i++) {
+			pool.node[i] = NO_NODE;
+			pool.next[i] = i+1 < pool.capacity ? i+1 : -1;
+		}
+		pool.freeHead = old;
+	}
+	int slot = pool.freeHead;
+	pool.freeHead = pool.next[slot];
+	return slot;
+}
+
+static void linkBack(FringePool& pool, FringeList& list, int slot) {
+	pool.next[slot] = -1;
+	pool.prev[slot] = list.tail;
+	if (list.tail == -1) list.head = slot;
+	else pool.next[list.tail] = slot;
+	list.tail = slot;
+	list.size++;
+	pool.list[slot] = list.id;
+}
+
+//links slot in right behind after, which is in list
+static void linkAfter(FringePool& pool, FringeList& list, int after, int slot) {
+	int next = pool.next[after];
+	pool.prev[slot] = after;
+	pool.next[slot] = next;
+	pool.next[after] = slot;
+	if (next == -1) list.tail = slot;
+	else pool.prev[next] = slot;
+	list.size++;
+	pool.list[slot] = list.id;
+}
+
+static void unlink(FringePool& pool, FringeList& list, int slot) {
+	int prev = pool.prev[slot];
+	int next = pool.next[slot];
+	if (prev == -1) list.head = next;
+	else pool.next[prev] = next;
+	if (next == -1) list.tail = prev;
+	else pool.prev[next] = prev;
+	list.size--;
+}
+
+//queues node at the back of list, and records the slot in the map so an improvement can
+// find it again (see requeue)
+static void pushBack(FringePool& pool, FringeList& list, Map& map, NodeId node) {
+	int slot = allocSlot(pool);
+	pool.node[slot] = node;
+	linkBack(pool, list, slot);
+	__atomic_store_n(fringeSlotWord(map, node), slot, __ATOMIC_RELAXED);
+}
+
+//removes a slot for good, returning it to the free list. A free slot holds no node, so a
+// stale slot recorded in the map never matches it
+static void release(FringePool& pool, FringeList& list, int slot) {
+	unlink(pool, list, slot);
+	pool.node[slot] = NO_NODE;
+	pool.next[slot] = pool.freeHead;
+	pool.freeHead = slot;
+}
+
+static SearchKernel kernelFor(MetaMap* mmap, int numGoals);
+
 fs* buildFS(MetaMap* mmap, int increment, coord start, coord* goals, int numGoals) {
 	fs* search = (fs*)malloc(sizeof(fs));
 	search->mmap = mmap;
@@ -29,44 +152,277 @@ fs* buildFS(MetaMap* mmap, int increment, coord start, coord* goals, int numGoal
 
 	int minH = INT_MAX;
 	for (int g = 0; g < numGoals; g++) {
-		int temp = manhattan(start, goals[g]);
+		int temp = estimate(mmap, getNode(*mmap->real, start.x, start.y), start, goals[g]);
 		if (minH > temp) minH = temp;
 	}
 	search->threshold = minH;
 
-	search->now = new list<Node*>();
-	search->later = new list<Node*>();
-	search->paths = new list<Node*>*[numGoals];
+	initFringePool(search->pool);
+	initFringeList(search->now, NOW_LIST);
+	initFringeList(search->later, LATER_LIST);
+	search->paths = new list<NodeId>*[numGoals];
 	for (int i = 0; i < numGoals; i++) {
 		//all paths start null, will be set once a path is found
 		search->paths[i] = NULL;
 	}
+	search->team = search;
+	search->active = 1;
+	search->kernel = kernelFor(mmap, numGoals);
 
-	Node* origin = getNode(search->mmap->real, search->start.x, search->start.y);
-	origin->owner = origin;
-	origin->cost = 0;
-	search->now->push_front(origin);
+	Map* real = search->mmap->real;
+	search->owner = claimOwner(real, start);
+	NodeId origin = getNode(real, search->start.x, search->start.y);
+	storeState(*real, origin, packState(0, search->owner, DIR_NONE) | STATE_IN_FRINGE);
+	pushBack(search->pool, search->now, *real, origin);
 
 	return search;
 }
 
-list<Node*>* getPath(Node* end) {
-	list<Node*>* path = new list<Node*>();
-	Node* temp = end;
-	while (temp != NULL) {
+list<NodeId>* getPath(Map& map, NodeId end) {
+	list<NodeId>* path = new list<NodeId>();
+	NodeId temp = end;
+	while (temp != NO_NODE) {
 		path->push_front(temp);
-		temp = temp->parent;
+		temp = parentOf(map, temp);
 	}
 	return path;
 }
 
-int fsearch(fs* fs, int maxIterations) {
+//releases an instance built by buildFS or splitFS. Paths it found are left alone, since the
+// caller usually still needs them, but the paths array itself is freed along with the
+// instance that built it (a helper shares its team's)
+void freeFS(fs* search) {
+	arenaFree(search->pool.node);
+	arenaFree(search->pool.next);
+	arenaFree(search->pool.prev);
+	arenaFree(search->pool.list);
+	if (search->team == search) delete[] search->paths;
+	free(search);
+}
+
+//claimWith results
+#define CLAIMED    0 //child now belongs to this instance at the new cost
+#define IMPROVED   1 //as CLAIMED, but child is already waiting in now/later so isn't pushed again
+#define NOT_BETTER 2 //this instance already reached child at least as cheaply
+#define FOREIGN    3 //another instance owns child
+
+//the original scheme: one omp lock per high level square guards every cell inside it
+static int claimLocked(fs* fs, NodeId child, coord childCoord, NodeState want, int* otherOwner, ThreadStats* stats) {
+	Map& map = *(fs->mmap->real);
+	omp_lock_t * childLock = lockFor(fs->mmap, childCoord);
+
+	if (!statsEnabled) {
+		omp_set_lock(childLock);
+	}
+	else {
+		stats->lockAcquisitions++;
+		//only contended locks are timed, an uncontended one costs no more than before
+		if (!omp_test_lock(childLock)) {
+			uint64_t waitStart = statsClockNs();
+			omp_set_lock(childLock);
+			stats->lockContended++;
+			stats->lockWaitNs += statsClockNs() - waitStart;
+		}
+	}
+	NodeState old = loadState(map, child);
+	int owner = stateOwner(old);
+	int result;
+	//if the child isn't owned by another process
+	if (owner == 0 || owner == fs->owner) {
+		if (stateCost(old) > stateCost(want)) { //and the path we've found to it is best so far
+			storeState(map, child, want | (old & STATE_IN_FRINGE));
+			result = (old & STATE_IN_FRINGE) ? IMPROVED : CLAIMED;
+		}
+		else {
+			result = NOT_BETTER;
+		}
+	}
+	else {
+		*otherOwner = owner;
+		result = FOREIGN;
+	}
+	omp_unset_lock(childLock);
+	return result;
+}
+
+//lock free: owner, cost and parent change together in one compare-and-swap of the state word
+static int claimAtomic(fs* fs, NodeId child, NodeState want, int* otherOwner, ThreadStats* stats) {
+	Map& map = *(fs->mmap->real);
+	NodeState* word = stateWord(map, child);
+	NodeState raw = loadRawState(map, child);
+	want |= map.stamp;
+	while (true) {
+		NodeState old = currentState(map, raw);
+		int owner = stateOwner(old);
+		if (owner != 0 && owner != fs->owner) {
+			*otherOwner = owner;
+			return FOREIGN;
+		}
+		if (stateCost(old) <= stateCost(want)) return NOT_BETTER;
+		//a failed exchange reloads raw, so the checks above run again against the winner's value
+		if (__atomic_compare_exchange_n(word, &raw, want | (old & STATE_IN_FRINGE), false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+			return (old & STATE_IN_FRINGE) ? IMPROVED : CLAIMED;
+		}
+		if (statsEnabled) stats->casRetries++;
+	}
+}
+
+//tries to make this instance the owner of child, with the claim mode known at compile time.
+//want is the packed state to give it: cost, owner and parent, plus STATE_IN_FRINGE when the
+// caller is about to push it (not for cells a jump passes over). A cell already waiting
+// keeps its mark
+template <int CLAIM>
+static inline int claimWith(fs* fs, NodeId child, coord childCoord, NodeState want, int* otherOwner, ThreadStats* stats) {
+	if (CLAIM == CLAIM_CAS) return claimAtomic(fs, child, want, otherOwner, stats);
+	return claimLocked(fs, child, childCoord, want, otherOwner, stats);
+}
+
+//from reached a cell of owner, which may be the instance one of our goals belongs to
+static void meetOwner(fs* fs, Map& map, NodeId from, NodeId child, int childOwner, ThreadStats* stats) {
+	if (statsEnabled) stats->collisions++;
+	//we've found a path to another process
+	for (int g = 0; g < fs->numGoals; g++) {
+		if (fs->goals[g] == map.origins[childOwner] && __atomic_load_n(&(fs->paths[g]), __ATOMIC_ACQUIRE) == NULL) {
+			list<NodeId>* pathToN = getPath(map, from);
+			pathToN->push_back(child);
+			//paths is shared by the whole team, another member may have beaten us to it
+			list<NodeId>* expected = NULL;
+			if (__atomic_compare_exchange_n(&(fs->paths[g]), &expected, pathToN, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+				__atomic_add_fetch(&(fs->team->goalsFound), 1, __ATOMIC_ACQ_REL);
+				if (statsEnabled) stats->goalsMet++;
+			}
+			else {
+				delete pathToN;
+			}
+		}
+	}
+}
+
+//child got cheaper while waiting in a fringe. If it waits in one of this instance's lists
+// it's moved right behind the node being expanded, now's head, as in classic fringe
+// search, so it's expanded next at its new cost rather than where it waited, possibly
+// past the next threshold bump. A child a team member holds stays where it is, that
+// member reads the new cost when it gets to it
+static void requeue(fs* fs, Map& map, NodeId child, ThreadStats* stats) {
+	if (statsEnabled) stats->duplicates++;
+	FringePool& pool = fs->pool;
+	int slot = __atomic_load_n(fringeSlotWord(map, child), __ATOMIC_RELAXED);
+	if (slot < 0 || slot >= pool.capacity || pool.node[slot] != child) return;
+	int current = fs->now.head;
+	if (slot == current || pool.prev[slot] == current) return;
+	unlink(pool, pool.list[slot] == fs->now.id ? fs->now : fs->later, slot);
+	linkAfter(pool, fs->now, current, slot);
+}
+
+//jump point pruning for the 4-connected grid (EXPAND_JUMP). Of all the equally short paths
+// between two cells only the one taking its horizontal (x) moves first is searched, so:
+//  - a cell reached along x continues along x, or turns to either y direction
+//  - a cell reached along y only continues along y, unless a cell beside it is open while
+//    the one beside its predecessor is blocked; then the turn is forced, no horizontal
+//    first path could have got there
+//Jumps run straight until a cell where a turn is forced, or from which a y jump finds
+// one, and only that jump point is queued. Cells owned by other instances stop jumps too,
+// so collisions are still found, and the cells jumped over are claimed on the way so
+// getPath and other instances see them like any others
+static const int stepX[] = {1, -1, 0, 0};
+static const int stepY[] = {0, 0, 1, -1};
+
+static bool openCell(Map& map, int x, int y) {
+	return validX(map, x) && validY(map, y) && !isBlocked(map, x, y);
+}
+
+static bool horizontal(int dir) {
+	return dir == DIR_XPLUS || dir == DIR_XMINUS;
+}
+
+//a turn to dx is forced at (x,y), reached moving dir along y
+static bool forcedTurn(Map& map, int x, int y, int dir, int dx) {
+	return openCell(map, x + dx, y) && !openCell(map, x + dx, y - stepY[dir]);
+}
+
+static bool foreignCell(fs* fs, Map& map, NodeId cell) {
+	int owner = stateOwner(loadState(map, cell));
+	return owner != 0 && owner != fs->owner;
+}
+
+//how many steps from n, at c, in dir the next jump point is, 0 if there is none
+static int jumpLength(fs* fs, Map& map, NodeId n, coord c, int dir) {
+	int steps = 0;
+	while (true) {
+		c.x += stepX[dir];
+		c.y += stepY[dir];
+		if (!validX(map, c.x) || !validY(map, c.y)) return 0;
+		n = neighborOf(map, n, dir);
+		if (isBlocked(map, n)) return 0;
+		steps++;
+		if (foreignCell(fs, map, n)) return steps;
+		if (horizontal(dir)) {
+			//y neighbors are adjacent in memory, so these scans are cheap
+			if (jumpLength(fs, map, n, c, DIR_YPLUS) > 0 || jumpLength(fs, map, n, c, DIR_YMINUS) > 0) return steps;
+		}
+		else if (forcedTurn(map, c.x, c.y, dir, 1) || forcedTurn(map, c.x, c.y, dir, -1)) {
+			return steps;
+		}
+	}
+}
+
+//walks the jump from n, claiming every cell on the way and queueing the last one
+template <int CLAIM>
+static void jump(fs* fs, Map& map, NodeId n, int nCost, int dir, int steps, ThreadStats* stats) {
+	coord c = coordOf(map, n);
+	NodeId prev = n;
+	for (int s = 1; s <= steps; s++) {
+		c.x += stepX[dir];
+		c.y += stepY[dir];
+		NodeId cell = neighborOf(map, prev, dir);
+		bool last = s == steps;
+		int cellOwner;
+		NodeState want = packState(nCost + s, fs->owner, oppositeDir(dir)) | (last ? STATE_IN_FRINGE : 0);
+		int claim = claimWith<CLAIM>(fs, cell, c, want, &cellOwner, stats);
+		if (claim == FOREIGN) {
+			meetOwner(fs, map, prev, cell, cellOwner, stats);
+			return;
+		}
+		if (last) {
+			if (claim == CLAIMED) pushBack(fs->pool, fs->now, map, cell);
+			else if (claim == IMPROVED) requeue(fs, map, cell, stats);
+		}
+		//cells reached at least as cheaply are walked through: they're still ours, and
+		// cheaper, so the cells after them keep a consistent chain of parents
+		prev = cell;
+	}
+}
+
+template <int CLAIM>
+static void expandJumps(fs* fs, Map& map, NodeId n, coord nc, int nCost, int parentDir, ThreadStats* stats) {
+	for (int dir = 0; dir < 4; dir++) {
+		if (parentDir != DIR_NONE) {
+			int arrived = oppositeDir(parentDir);
+			if (dir == parentDir) continue;
+			if (!horizontal(arrived) && dir != arrived && !forcedTurn(map, nc.x, nc.y, arrived, stepX[dir])) continue;
+		}
+		int steps = jumpLength(fs, map, n, nc, dir);
+		if (steps > 0) jump<CLAIM>(fs, map, n, nCost, dir, steps, stats);
+	}
+}
+
+//the search loop, specialized on what stays the same for the whole life of an instance:
+//  GOALS      1 or 2 (what ripple segments have), or 0 for any number
+//  HEURISTIC  HEURISTIC_MANHATTAN, or HEURISTIC_ALT when the map has landmarks
+//  CLAIM      the map's claim mode
+//  EXPANSION  the map's expansion, how the neighbors of a node are generated
+//so the loop over goals is unrolled and the per node checks of those settings are gone.
+// buildFS picks the instantiation (see kernelFor)
+template <int GOALS, int HEURISTIC, int CLAIM, int EXPANSION>
+static int searchKernel(fs* fs, int maxIterations) {
+	Map& map = *(fs->mmap->real);
+	ThreadStats* stats = statsEnabled ? threadStats() : NULL;
 	//cout << "fsearch call" << endl << flush;
 	int lastListSwap = -1;
 	for (int i = 0; i < maxIterations; i++) {
 		//cout << "it " << i << endl << flush;
 		//if we've exanded through the current threshold
-		if (fs->now->empty()) {
+		if (fs->now.size == 0) {
 			//cout << "FS Reached End" << endl << flush;
 			if (lastListSwap == i) {             // the current fs instance is out of nodes
 				//cout << "Ret -1" << endl << flush;
@@ -77,108 +433,178 @@ int fsearch(fs* fs, int maxIterations) {
 				lastListSwap = i;
 
 				fs->threshold += fs->increment;
+				if (statsEnabled) stats->thresholdBumps++;
 
-				if (fs->later == NULL) {
-					cout << "WARN - LATER LIST IS NULL" << endl << flush;
-				}
-
-				delete fs->now;
+				//both lists live in the same pool, so swapping is just swapping their ends
+				int emptied = fs->now.id;
 				fs->now = fs->later;
-				fs->later = new list<Node*>();
-
-				if (fs->now == NULL) {
-					cout << "WARN - NOW LIST IS NULL" << endl << flush;
-				}
+				initFringeList(fs->later, emptied);
 			}
 			i--;
 		}
 		else {
-			Node* n = fs->now->front();
+			int slot = fs->now.head;
+			NodeId n = fs->pool.node[slot];
+			coord nc = coordOf(map, n);
+			int nCost = stateCost(loadState(map, n));
 
 			int f = INT_MAX;      //will be the smallest f value of candidate goals
-			for (int g = 0; g < fs->numGoals; g++) {
+			int numGoals = GOALS > 0 ? GOALS : fs->numGoals;
+			for (int g = 0; g < numGoals; g++) {
 				//if we already have a path to a given goal, don't use
 				// it as a candidate for the best heuristic value
-				if (fs->paths[g] != NULL) continue;
+				if (__atomic_load_n(&(fs->paths[g]), __ATOMIC_RELAXED) != NULL) continue;
 
-				int fTemp = n->cost + manhattan(n->coordinate, fs->goals[g]);
+				int fTemp = nCost + estimateWith<HEURISTIC>(fs->mmap, n, nc, fs->goals[g]);
 				if (fTemp < f) f = fTemp;
 			}
 
 			if (f > fs->threshold) {
-				fs->later->push_back(n);
+				unlink(fs->pool, fs->now, slot);
+				linkBack(fs->pool, fs->later, slot);
+				if (statsEnabled) stats->deferred++;
 			}
 			else {
-				//cout << "expand node: " << n->coordinate.x << " " << n->coordinate.y << endl << flush;
+				//clear the mark before expanding, so a team member that improves n meanwhile
+				// queues it again instead of assuming this expansion will use the new cost
+				NodeState nState = __atomic_fetch_and(stateWord(map, n), ~STATE_IN_FRINGE, __ATOMIC_RELAXED);
+				if (statsEnabled) stats->expanded++;
+				if (EXPANSION == EXPAND_JUMP) {
+					expandJumps<CLAIM>(fs, map, n, nc, nCost, stateParent(currentState(map, nState)), stats);
+					release(fs->pool, fs->now, slot);
+					continue;
+				}
+				//cout << "expand node: " << nc.x << " " << nc.y << endl << flush;
 				//expand children
-				int nx = n->coordinate.x;
-				int ny = n->coordinate.y;
+				int nx = nc.x;
+				int ny = nc.y;
 				int x[] = {nx+1, nx-1, nx, nx  };
 				int y[] = {ny,   ny, ny+1, ny-1};
+				//away from the edges every neighbor is on the map, one check covers all four. A
+				// padded map has no edges, its ring is blocked like any obstacle
+				bool interior = map.layout == LAYOUT_PADDED || (nx > 0 && nx < map.rows-1 && ny > 0 && ny < map.cols-1);
 				for (int i = 0; i < 4; i++) {
 					//if coordinate pair is valid
-					if (x[i] >= 0 && x[i] < fs->mmap->real->cols && y[i] >= 0 && y[i] < fs->mmap->real->cols) {
-						Node* child = getNode(fs->mmap->real, x[i], y[i]);
-
+					if (interior || (validX(map, x[i]) && validY(map, y[i]))) {
+						NodeId child = neighborOf(map, n, i);
 
 
-						if (!isBlocked(child)) {
 
-							omp_lock_t * childLock = lockFor(fs->mmap, child->coordinate);
+						if (!isBlocked(map, child)) {
 
-							omp_set_lock(childLock);
-							//if the child isn't owned by another process
-							if (child->owner == NULL || child->owner->coordinate == fs->start) {
-								if (child->cost > n->cost+1) { //and the path we've found to it is best so far
-									child->owner = n->owner; //make sure we own it
-									omp_unset_lock(childLock); //setting the owner ensures that this instance owns the node
-									child->parent = n;
-									child->cost = n->cost+1;                                 //set its cost appropriately
-									fs->now->push_back(child);
-									//cout << "push child: " << child->coordinate.x << " " << child->coordinate.y << endl << flush;
-								}
-								else {
-									omp_unset_lock(childLock);
-								}
+							coord childCoord = {x[i], y[i]};
+							int childOwner;
+							int claim = claimWith<CLAIM>(fs, child, childCoord, packState(nCost+1, fs->owner, oppositeDir(i)) | STATE_IN_FRINGE, &childOwner, stats);
+							if (claim == CLAIMED) {
+								pushBack(fs->pool, fs->now, map, child);
+								//cout << "push child: " << x[i] << " " << y[i] << endl << flush;
 							}
-							else {
-								omp_unset_lock(childLock); //no more need for synchronization
-								//we've found a path to another process
-								for (int g = 0; g < fs->numGoals; g++) {
-									if (fs->goals[g] == child->owner->coordinate && fs->paths[g] == NULL) {
-										fs->goalsFound++;
-										list<Node*>* pathToN = getPath(n);
-										pathToN->push_back(child);
-										fs->paths[g] = pathToN;
-									}
-								}
+							else if (claim == IMPROVED) {
+								requeue(fs, map, child, stats);
+							}
+							else if (claim == FOREIGN) {
+								meetOwner(fs, map, n, child, childOwner, stats);
 							}
-
-							//TODO: UNLOCK this node
 						}
 						else {
 							//printf("BLOCKED\n");
 						}
 					}
 				}
+				release(fs->pool, fs->now, slot);
 			}
-			fs->now->pop_front();
 		}
 	}
 	return 0; //zero indicates the pathfinding instance isn't out of nodes
 }
 
-list<coord>* hlsearch(MetaMap * mmap, coord start, coord goal) {
-	cout << "Enter HL Search" << endl << flush;
+template <int GOALS, int HEURISTIC, int CLAIM>
+static SearchKernel kernelWithExpansion(MetaMap* mmap) {
+	if (mmap->expansion == EXPAND_JUMP) return searchKernel<GOALS, HEURISTIC, CLAIM, EXPAND_JUMP>;
+	return searchKernel<GOALS, HEURISTIC, CLAIM, EXPAND_ALL>;
+}
+
+template <int GOALS, int HEURISTIC>
+static SearchKernel kernelWithClaim(MetaMap* mmap) {
+	if (mmap->claimMode == CLAIM_CAS) return kernelWithExpansion<GOALS, HEURISTIC, CLAIM_CAS>(mmap);
+	return kernelWithExpansion<GOALS, HEURISTIC, CLAIM_LOCK>(mmap);
+}
+
+template <int GOALS>
+static SearchKernel kernelWithHeuristic(MetaMap* mmap) {
+	if (mmap->landmarks != NULL) return kernelWithClaim<GOALS, HEURISTIC_ALT>(mmap);
+	return kernelWithClaim<GOALS, HEURISTIC_MANHATTAN>(mmap);
+}
+
+static SearchKernel kernelFor(MetaMap* mmap, int numGoals) {
+	if (numGoals == 1) return kernelWithHeuristic<1>(mmap);
+	if (numGoals == 2) return kernelWithHeuristic<2>(mmap);
+	return kernelWithHeuristic<0>(mmap);
+}
+
+int fsearch(fs* fs, int maxIterations) {
+	return fs->kernel(fs, maxIterations);
+}
+
+//don't bother splitting fringes smaller than this, the helper would be done before it started
+#define MIN_DONATION 64
+
+static void donate(fs* victim, FringeList& from, fs* helper, FringeList& to, int count) {
+	for (int i = 0; i < count; i++) {
+		int slot = from.tail;
+		NodeId n = victim->pool.node[slot];
+		release(victim->pool, from, slot);
+		pushBack(helper->pool, to, *victim->mmap->real, n);
+	}
+}
+
+//moves about half of victim's fringe into a new helper instance on the same team, for an
+// idle thread to search. The donated cells keep their in-fringe mark since the team still
+// holds them. Returns NULL when there isn't enough left to be worth splitting
+fs* splitFS(fs* victim) {
+	int later = victim->later.size;
+	int now = victim->now.size;
+	if (later + now < 2 * MIN_DONATION || teamFinished(victim)) return NULL;
+
+	fs* helper = (fs*)malloc(sizeof(fs));
+	*helper = *victim;
+	helper->iterations = 0;
+	helper->goalsFound = 0;
+	helper->active = 0;
+	initFringePool(helper->pool);
+	initFringeList(helper->now, NOW_LIST);
+	initFringeList(helper->later, LATER_LIST);
+
+	//prefer nodes past the threshold, the victim is about to need its current ones
+	int wanted = (later + now) / 2;
+	int fromLater = min(wanted, later);
+	donate(victim, victim->later, helper, helper->later, fromLater);
+	donate(victim, victim->now, helper, helper->now, wanted - fromLater);
+
+	__atomic_add_fetch(&(victim->team->active), 1, __ATOMIC_ACQ_REL);
+	return helper;
+}
 
+//true once the team this instance belongs to has paths to all of its goals
+bool teamFinished(fs* fs) {
+	return __atomic_load_n(&(fs->team->goalsFound), __ATOMIC_ACQUIRE) == fs->numGoals;
+}
+
+list<coord>* hlsearch(MetaMap * mmap, coord start, coord goal) {
 	coord hlStart = bigToLittle(mmap, start);
 	coord hlGoal = bigToLittle(mmap, goal);
 
+	//forget the previous high level search without touching the meta nodes
+	newSearch(*(mmap->meta));
+
 	MetaMap fake_mmap = {
 		mmap->meta, //real
 		mmap->meta, //meta
 		mmap->locks,
-		1
+		1,
+		mmap->claimMode,
+		mmap->expansion,
+		NULL //the landmarks are for the real map
 	};
 //fs* buildFS(MetaMap* mmap, int increment, coord start, coord* goals, int numGoals)
 	coord goalClaimerGoals[] = {hlStart};
@@ -198,8 +624,6 @@ list<coord>* hlsearch(MetaMap * mmap, coord start, coord goal) {
 		1
 	);
 
-	cout << "HLSearch: Completed setup. About to run search" << endl << flush;
-
 	int arbitraryIteration = 10;
 	while (search->goalsFound == 0) {
 		if (fsearch(search, arbitraryIteration) == -1) {
@@ -207,28 +631,26 @@ list<coord>* hlsearch(MetaMap * mmap, coord start, coord goal) {
 				break;
 			}
 			else {
+				freeFS(goalClaimer);
+				freeFS(search);
 				return NULL; //null retval means no high level path
 			}
 		}
 	}
 	//found a high level path if this point is reached
 
-	//FIRST restore mmap's meta component to its original form
-	Map * meta = mmap->meta;
-	int metaNodes = meta->rows * meta->cols;
-	for (int i = 0; i < metaNodes; i++) {
-		meta->nodes[i].parent = NULL;
-		meta->nodes[i].owner = NULL;
-		meta->nodes[i].cost = INT_MAX;
-	}
-
 	//finally, construct the path from fs:
 	list<coord> * ret = new list<coord>();
-	list<Node*>::iterator it = search->paths[0]->begin();
+	list<NodeId>::iterator it = search->paths[0]->begin();
 	while (it != search->paths[0]->end()) {
-		ret->push_back((*it)->coordinate);
+		ret->push_back(coordOf(*(mmap->meta), *it));
 		it++;
 	}
+	delete search->paths[0];
+
+	//the map's epoch takes care of the nodes, so this is all a repeated query has to clean up
+	freeFS(goalClaimer);
+	freeFS(search);
 
 	return ret;
 }
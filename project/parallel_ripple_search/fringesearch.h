@@ -8,6 +8,29 @@
 
 using namespace std;
 
+//slot pool for the fringe lists of one search instance. Slots are linked by index through
+// flat arrays, so pushing, unlinking and moving a node between lists never allocates
+// (the arrays only grow, by doubling, when every slot is in use)
+struct FringePool {
+	NodeId* node; //node held by each slot
+	int* next;    //next slot in the same list, -1 at the tail
+	int* prev;    //previous slot in the same list, -1 at the head
+	unsigned char* list; //id of the list the slot is linked into (FringeList::id)
+	int capacity;
+	int freeHead; //unused slots, linked through next
+};
+
+struct FringeList {
+	int head;
+	int tail;
+	int size;
+	int id; //told apart in FringePool::list, now and later trade ids when they swap
+};
+
+struct fs;
+//one specialization of the search loop, see fsearch
+typedef int (*SearchKernel)(fs* fs, int maxIterations);
+
 struct fs {
 	int iterations;
 
@@ -19,16 +42,27 @@ struct fs {
 
 	coord start;
 
+	int owner; //id this instance marks the cells it claims with
+
 	coord * goals;
 
 	int goalsFound;
 
 	int numGoals;
 
-	list<Node*> * now; // = new list<Node*>();
-	list<Node*> * later; // = new list<Node*>();
+	FringePool pool;
+	FringeList now;
+	FringeList later;
+
+	list<NodeId> ** paths; //as many paths as there are goals
 
-	list<Node*> ** paths; //as many paths as there are goals
+	//an instance can hand part of its fringe to helper instances run by other threads.
+	// Helpers claim cells as the same owner and share goals and paths with the instance
+	// they came from, so together they behave like a single search
+	fs * team;  //the instance this one was split from (itself for instances from buildFS)
+	int active; //team members which still have nodes, only meaningful on the team
+
+	SearchKernel kernel; //chosen by buildFS for its goal count and map settings
 };
 
 int manhattan(int, int, int, int);
@@ -36,12 +70,16 @@ int manhattan(int, int, int, int);
 int manhattan(coord a, coord b);
 
 fs* buildFS(MetaMap* mmap, int increment, coord start, coord* goals, int numGoals);
+void freeFS(fs* search);
 
 int fsearch(fs* fs, int maxIterations);
 
+fs* splitFS(fs* victim);
+bool teamFinished(fs* fs);
+
 list<coord>* hlsearch(MetaMap * mmap, coord start, coord goal);
 
 //list<Node*>* getPath(fs* fs, Node* end);
-list<Node*>* getPath(Node* end);
+list<NodeId>* getPath(Map& map, NodeId end);
 
 #endif
@@ -1,5 +1,6 @@
 #include "nodemap.h"
 #include "fringesearch.h"
+#include "mapfile.h"
 
 #include <math.h>
 
@@ -8,33 +9,52 @@
 
 using namespace std;
 
-int main() {
-	MapParams params = {
-		16, //sidelen
-		.0, //obsratio
-		.0 / log2(16) //change
-	};
-	MetaMap* mmap = buildMap(
-	    params,
-	    1, //seed
-	    4 //max sidelength for hl
-	    );
+//optionally takes a map file (see mapfile.h) to search instead of the built in 16x16 map
+int main(int argc, char** argv) {
+	MetaMap* mmap = NULL;
+	if (argc > 1) {
+		MapParams fileParams = {0}; //dense state, no tile budget
+		int fileSeed;
+		int loaded = loadMapFile(argv[1], &fileParams, &fileSeed, &mmap);
+		if (loaded != MAPFILE_LOADED) {
+			if (loaded == MAPFILE_MISSING) cout << "There is no " << argv[1] << endl << flush;
+			cout << "Couldn't load " << argv[1] << endl << flush;
+			return 1;
+		}
+	}
+	else {
+		MapParams params = {
+			16, //sidelen
+			.0, //obsratio
+			.0 / log2(16) //change
+		};
+		mmap = buildMap(
+		    params,
+		    1, //seed
+		    4 //max sidelength for hl
+		    );
+	}
+	int last = mmap->real->cols - 1;
+	coord start = {0,0};
+	coord end = {last,last};
+	setBlocked(*mmap->real, getNode(mmap->real, start.x, start.y), 0);
+	setBlocked(*mmap->real, getNode(mmap->real, end.x, end.y), 0);
 
-	coord goals[] = {{15,15}}; //one goal
+	coord goals[] = {end}; //one goal
 	fs* search = buildFS(
 	    mmap,
 	    3, //increment
-	    {0,0}, //start
+	    start, //start
 	    goals, //the goals
 	    1 //numGoals
 	    );
 
 	//necessary for another instance to claim the goal (otherwise it won't be recognized as a goal)
-	coord otherGoal[] = {{0,0}};
+	coord otherGoal[] = {start};
 	fs* other = buildFS(
 	    mmap,
 	    3,
-	    {15,15},
+	    end,
 	    otherGoal,
 	    1
 	    );
@@ -48,11 +68,11 @@ int main() {
 	if (search->goalsFound == 1) {
 
 		cout << "found path!" << endl << flush;
-		list<Node*>::iterator it = search->paths[0]->begin();
+		list<NodeId>::iterator it = search->paths[0]->begin();
 		while (it != search->paths[0]->end()) {
-			Node* n = *it;
-			//printf("%d, %d\n", n->coordinate.x, n->coordinate.y);
-			cout << "node " << n->coordinate.x << " " << n->coordinate.y << endl << flush;
+			coord n = coordOf(*mmap->real, *it);
+			//printf("%d, %d\n", n.x, n.y);
+			cout << "node " << n.x << " " << n.y << endl << flush;
 			it++;
 		}
 
@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "landmarks.h"
+
+using namespace std;
+
+//the free cell nearest to c, in growing squares around it
+static coord nearestFree(Map& map, coord c) {
+	for (int r = 0; r < map.rows || r < map.cols; r++) {
+		for (int x = c.x - r; x <= c.x + r; x++) {
+			for (int y = c.y - r; y <= c.y + r; y++) {
+				if (abs(x - c.x) != r && abs(y - c.y) != r) continue;
+				if (validX(map, x) && validY(map, y) && !isBlocked(map, x, y)) {
+					coord free = {x, y};
+					return free;
+				}
+			}
+		}
+	}
+	return c;
+}
+
+//walks the border of the map, count evenly spaced stops starting at a corner
+static coord borderPoint(Map& map, int k, int count) {
+	int64_t perimeter = 2 * ((int64_t)(map.rows - 1) + (map.cols - 1));
+	int64_t along = perimeter * k / count;
+	coord c = {0, 0};
+	if (along < map.rows - 1) { c.x = along; return c; }
+	along -= map.rows - 1;
+	c.x = map.rows - 1;
+	if (along < map.cols - 1) { c.y = along; return c; }
+	along -= map.cols - 1;
+	c.y = map.cols - 1;
+	if (along < map.rows - 1) { c.x = map.rows - 1 - along; return c; }
+	along -= map.rows - 1;
+	c.x = 0;
+	c.y = map.cols - 1 - along;
+	return c;
+}
+
+//breadth first, a level at a time, so every cell of a level gets the same quantum
+static void distanceField(Map& map, coord origin, int shift, uint16_t* field) {
+	NodeId cells = map.cells;
+	for (NodeId n = 0; n < cells; n++) field[n] = LANDMARK_UNREACHED;
+	if (isBlocked(map, origin.x, origin.y)) return;
+
+	vector<NodeId> level, next;
+	NodeId first = getNode(map, origin.x, origin.y);
+	field[first] = 0;
+	level.push_back(first);
+	for (int64_t d = 1; !level.empty(); d++) {
+		uint16_t quantum = (d >> shift) < LANDMARK_SATURATED ? (uint16_t)(d >> shift) : LANDMARK_SATURATED;
+		next.clear();
+		for (size_t i = 0; i < level.size(); i++) {
+			NodeId n = level[i];
+			coord c = coordOf(map, n);
+			int x[] = {c.x+1, c.x-1, c.x, c.x  };
+			int y[] = {c.y,   c.y, c.y+1, c.y-1};
+			for (int dir = 0; dir < 4; dir++) {
+				if (!validX(map, x[dir]) || !validY(map, y[dir])) continue;
+				NodeId child = neighborOf(map, n, dir);
+				if (field[child] != LANDMARK_UNREACHED || isBlocked(map, child)) continue;
+				field[child] = quantum;
+				next.push_back(child);
+			}
+		}
+		level.swap(next);
+	}
+}
+
+Landmarks* buildLandmarks(Map& map, int count) {
+	NodeId cells = map.cells;
+	Landmarks* landmarks = (Landmarks*) malloc(sizeof(Landmarks));
+	landmarks->count = count;
+	landmarks->cells = (coord*) malloc(count * sizeof(coord));
+	//paths around obstacles are rarely more than twice the perimeter, size the quanta so
+	// those still fit
+	landmarks->shift = 0;
+	while (((4 * ((int64_t)map.rows + map.cols)) >> landmarks->shift) >= LANDMARK_SATURATED) landmarks->shift++;
+
+	//one field per landmark first, so the searches don't share cache lines, then
+	// interleaved into the table
+	uint16_t* fields = (uint16_t*) malloc(cells * count * sizeof(uint16_t));
+	#pragma omp parallel for schedule(dynamic)
+	for (int k = 0; k < count; k++) {
+		landmarks->cells[k] = nearestFree(map, borderPoint(map, k, count));
+		distanceField(map, landmarks->cells[k], landmarks->shift, fields + cells * k);
+	}
+
+	landmarks->dist = (uint16_t*) malloc(cells * count * sizeof(uint16_t));
+	#pragma omp parallel for schedule(static)
+	for (NodeId n = 0; n < cells; n++) {
+		for (int k = 0; k < count; k++) {
+			landmarks->dist[n * count + k] = fields[cells * k + n];
+		}
+	}
+	free(fields);
+	return landmarks;
+}
+
+void freeLandmarks(Landmarks* landmarks) {
+	free(landmarks->cells);
+	free(landmarks->dist);
+	free(landmarks);
+}
@@ -0,0 +1,54 @@
+#include <stdint.h>
+
+#include "nodemap.h"
+
+#ifndef LANDMARKS_H
+#define LANDMARKS_H
+
+//ALT heuristic: exact distances from a few landmark cells to every cell. By the triangle
+// inequality |d(L,a) - d(L,b)| <= d(a,b) for any landmark L, so the largest of those
+// differences is an admissible estimate that sees the detours obstacles force, where
+// manhattan distance doesn't.
+//Distances are stored as 16 bit quanta of 2^shift cells, all landmarks of a cell next to
+// each other so an estimate reads one cache line per cell. shift is 0 while twice the
+// perimeter, 4 * (rows + cols), fits below LANDMARK_SATURATED, so up to 8191 cells a side
+// on square maps (8192 already takes shift 1); distances past the largest quantum
+// saturate, and only ever loosen the estimate. The table is only valid for the obstacles it was built from
+#define LANDMARK_UNREACHED 0xFFFF
+#define LANDMARK_SATURATED 0xFFFE
+#define DEFAULT_LANDMARKS 8
+
+struct Landmarks {
+	int count;
+	coord* cells;     //where each landmark is
+	uint16_t* dist;   //dist[node * count + k], LANDMARK_UNREACHED if k can't reach node
+	int shift;
+};
+
+//landmarks are spread around the border of the map, the breadth first searches from them
+// run in parallel
+Landmarks* buildLandmarks(Map& map, int count);
+void freeLandmarks(Landmarks* landmarks);
+
+//the largest lower bound any landmark gives on the distance between a and b, 0 if none does
+inline int landmarkBound(Landmarks* landmarks, NodeId a, NodeId b) {
+	uint16_t* da = landmarks->dist + a * landmarks->count;
+	uint16_t* db = landmarks->dist + b * landmarks->count;
+	int best = 0;
+	for (int k = 0; k < landmarks->count; k++) {
+		int qa = da[k];
+		int qb = db[k];
+		if (qa == LANDMARK_UNREACHED || qb == LANDMARK_UNREACHED) continue;
+		//each quantum stands for the distances [q << shift, ((q+1) << shift) - 1], and a
+		// saturated one for anything from its start up
+		int loA = qa << landmarks->shift;
+		int loB = qb << landmarks->shift;
+		int hiA = qa == LANDMARK_SATURATED ? INT_MAX : loA + (1 << landmarks->shift) - 1;
+		int hiB = qb == LANDMARK_SATURATED ? INT_MAX : loB + (1 << landmarks->shift) - 1;
+		if (hiB != INT_MAX && loA - hiB > best) best = loA - hiB;
+		if (hiA != INT_MAX && loB - hiA > best) best = loB - hiA;
+	}
+	return best;
+}
+
+#endif
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mapfile.h"
+#include "tiledfile.h"
+
+#define MAPFILE_ALIGN 4096
+
+static uint64_t alignUp(uint64_t offset) {
+	return (offset + MAPFILE_ALIGN - 1) / MAPFILE_ALIGN * MAPFILE_ALIGN;
+}
+
+static int writeAt(FILE* fp, uint64_t offset, const void* data, uint64_t bytes) {
+	if (fseeko(fp, offset, SEEK_SET) != 0) return 0;
+	return fwrite(data, 1, bytes, fp) == bytes;
+}
+
+//returns 1 on success
+int saveMapFile(const char* filename, MetaMap* mmap, MapParams params, int seed) {
+	if (mmap->real->procedural != NULL) {
+		printf("Procedural maps have no bitset to save, not writing %s\n", filename);
+		return 0;
+	}
+	MapFileHeader header;
+	memset(&header, 0, sizeof(header));
+	strncpy(header.magic, MAPFILE_MAGIC, sizeof(header.magic));
+	header.version = MAPFILE_VERSION;
+	header.headerBytes = sizeof(MapFileHeader);
+	header.sidelength = params.sidelength;
+	header.seed = seed;
+	header.obsratio = params.obsratio;
+	header.change = params.change;
+	header.realSide = mmap->real->cols;
+	header.metaSide = mmap->meta->cols;
+	header.factor = mmap->factor;
+	header.layout = mmap->real->layout;
+	header.realBytes = bitsetWords(*mmap->real) * sizeof(uint64_t);
+	header.metaBytes = bitsetWords(*mmap->meta) * sizeof(uint64_t);
+	header.realOffset = alignUp(sizeof(MapFileHeader));
+	header.metaOffset = alignUp(header.realOffset + header.realBytes);
+
+	FILE* fp = fopen(filename, "wb");
+	if (fp == NULL) {
+		printf("Couldn't open %s for writing\n", filename);
+		return 0;
+	}
+	int ok = writeAt(fp, 0, &header, sizeof(header)) &&
+	         writeAt(fp, header.realOffset, mmap->real->blocked, header.realBytes) &&
+	         writeAt(fp, header.metaOffset, mmap->meta->blocked, header.metaBytes);
+	if (fclose(fp) != 0) ok = 0;
+	if (!ok) printf("Failed writing %s\n", filename);
+	return ok;
+}
+
+//true if a bitset of bytes at offset lies within a file of size, page aligned and past
+// the header
+static bool sectionFits(uint64_t offset, uint64_t bytes, uint64_t size) {
+	return offset % MAPFILE_ALIGN == 0 && offset >= sizeof(MapFileHeader) &&
+	       offset <= size && bytes <= size - offset;
+}
+
+static uint64_t bitsetBytes(int side, int layout) {
+	return (layoutCells(side, layout) + 63) / 64 * sizeof(uint64_t);
+}
+
+//checks every field loadMapFile uses against what the map it describes needs, and
+// against the file's size. Returns the problem, or NULL if there's none
+static const char* headerProblem(MapFileHeader* header, uint64_t size) {
+	if (strncmp(header->magic, MAPFILE_MAGIC, sizeof(header->magic)) != 0) return "has no map file magic";
+	if (header->version != MAPFILE_VERSION || header->headerBytes != sizeof(MapFileHeader)) {
+		return "isn't a map file of this version";
+	}
+	if (header->layout != LAYOUT_PLAIN && header->layout != LAYOUT_PADDED && header->layout != LAYOUT_MORTON) {
+		return "has an unknown layout";
+	}
+	if (header->realSide < 1 || header->realSide > MAPFILE_MAX_SIDE || header->sidelength != header->realSide ||
+	    header->metaSide < 1 || header->metaSide > header->realSide ||
+	    header->factor != header->realSide / header->metaSide) {
+		return "has inconsistent side lengths";
+	}
+	if (!isfinite(header->obsratio) || !isfinite(header->change)) return "has a broken obstacle ratio";
+	if (header->realBytes != bitsetBytes(header->realSide, header->layout) ||
+	    header->metaBytes != bitsetBytes(header->metaSide, header->layout)) {
+		return "has bitsets of the wrong size for its sides";
+	}
+	if (!sectionFits(header->realOffset, header->realBytes, size) ||
+	    !sectionFits(header->metaOffset, header->metaBytes, size)) {
+		return "has a bitset that is misaligned or runs past its end";
+	}
+	if (header->realOffset < header->metaOffset + header->metaBytes &&
+	    header->metaOffset < header->realOffset + header->realBytes) {
+		return "has overlapping bitsets";
+	}
+	return NULL;
+}
+
+//maps the file and uses its bitsets in place as the obstacle grids. The mapping is
+// private, so the cells prs unblocks are copied on write while every untouched page stays
+// shared with the page cache (and any other process using the same file). With a tile
+// budget in params, only that much of the real bitset stays resident (see tiledfile.h).
+//params and seed receive the generation parameters. Only a path with nothing there is
+// MAPFILE_MISSING, any other file that can't be used is MAPFILE_INVALID
+int loadMapFile(const char* filename, MapParams* params, int* seed, MetaMap** loaded) {
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		if (errno == ENOENT) return MAPFILE_MISSING;
+		printf("Couldn't open %s: %s\n", filename, strerror(errno));
+		return MAPFILE_INVALID;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		printf("%s isn't a regular file\n", filename);
+		close(fd);
+		return MAPFILE_INVALID;
+	}
+	if ((uint64_t)st.st_size < sizeof(MapFileHeader)) {
+		printf("%s is too small to be a map file\n", filename);
+		close(fd);
+		return MAPFILE_INVALID;
+	}
+	char* base = (char*)mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd); //the mapping keeps the file open
+	if (base == MAP_FAILED) {
+		printf("Couldn't map %s\n", filename);
+		return MAPFILE_INVALID;
+	}
+
+	MapFileHeader* header = (MapFileHeader*)base;
+	const char* problem = headerProblem(header, st.st_size);
+	if (problem != NULL) {
+		printf("%s %s\n", filename, problem);
+		munmap(base, st.st_size);
+		return MAPFILE_INVALID;
+	}
+
+	Map* real = allocateMapLayout(header->realSide, header->change, (uint64_t*)(base + header->realOffset), header->layout, params->stateMode);
+	Map* meta = allocateMapLayout(header->metaSide, 0.0, (uint64_t*)(base + header->metaOffset), header->layout, STATE_DENSE);
+	if (params->tileBudget > 0) pageBitset(*real, params->tileBudget);
+	*loaded = assembleMetaMap(real, meta);
+
+	params->sidelength = header->sidelength;
+	params->obsratio = header->obsratio;
+	params->change = header->change;
+	params->layout = header->layout;
+	*seed = header->seed;
+	return MAPFILE_LOADED;
+}
@@ -0,0 +1,50 @@
+#include <stdint.h>
+
+#include "nodemap.h"
+
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#define MAPFILE_MAGIC "PRSMAP"
+#define MAPFILE_VERSION 1
+
+//binary map format. The header is followed by the real and high level obstacle bitsets,
+// each starting on a page boundary so they can be used straight out of the mapping
+struct MapFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t headerBytes;
+
+	//generation parameters, so a run can tell which map it is looking at
+	int32_t sidelength;
+	int32_t seed;
+	double obsratio;
+	double change;
+
+	int32_t realSide;
+	int32_t metaSide;
+	int32_t factor;
+	int32_t layout; //LAYOUT_* of both bitsets, files from before it was added have 0 (plain)
+
+	uint64_t realOffset;
+	uint64_t realBytes;
+	uint64_t metaOffset;
+	uint64_t metaBytes;
+};
+
+//loadMapFile results
+#define MAPFILE_LOADED  0
+#define MAPFILE_MISSING 1 //nothing at that path, so a map can be built and saved there
+#define MAPFILE_INVALID 2 //the file can't be read or isn't a map file, and is left alone.
+                          // The reason has been printed
+
+//the largest side a map file may claim
+#define MAPFILE_MAX_SIDE (1 << 28)
+
+int saveMapFile(const char* filename, MetaMap* mmap, MapParams params, int seed);
+//params gets the file's generation parameters, all but stateMode and tileBudget, which
+// aren't part of the map: the real map is loaded with the ones params asks for. loaded is
+// only set for MAPFILE_LOADED
+int loadMapFile(const char* filename, MapParams* params, int* seed, MetaMap** loaded);
+
+#endif
@@ -9,6 +9,9 @@
 #include <algorithm>
 
 #include "nodemap.h"
+#include "procedural.h"
+#include "tiledfile.h"
+#include "arena.h"
 
 using namespace std;
 
@@ -16,41 +19,171 @@ bool operator==(const coord& l, const coord& r) {
 	return l.x == r.x && l.y ==r.y;
 }
 
-double genRand() {
-	int percent = rand() % 100;
+//counter based random numbers: a draw depends only on the key of the quadtree square
+// making it and on which draw it is, never on the order squares are filled in
+uint64_t mixKey(uint64_t key, uint64_t salt) {
+	//splitmix64 finalizer
+	uint64_t z = key + 0x9E3779B97F4A7C15ULL * (salt + 1);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+double genRand(uint64_t key, int draw) {
+	int percent = mixKey(key, draw) % 100;
 	return percent == 0 ? 1.0 : ((double) percent) / 100.0;
 }
-double genRandSign() {
-	double val = (rand() % 100) >= 50 ? 1.0 : -1.0;
+double genRandSign(uint64_t key, int draw) {
+	double val = (mixKey(key, draw) % 100) >= 50 ? 1.0 : -1.0;
 	return val;
 }
 
-Node * getNode(Map& map, int x, int y) {
-	return &(map.nodes[indexOf(map, x, y)]);
+//what each draw of a square's key is used for. A square's own draws come first and its
+// quadrants' keys after them, so no quadrant's key is also one of its parent's draws
+#define DRAW_CHANGE   0
+#define DRAW_SIGN     1
+#define DRAW_LEAF     2
+#define SALT_QUADRANT 3 //upper left, then upper right, lower right and lower left
+
+bool leafBlocked(Bounds& leaf) {
+	return genRand(leaf.key, DRAW_LEAF) < leaf.perc;
 }
-Node * getNode(Map* map, int x, int y) {
+
+NodeId getNode(Map* map, int x, int y) {
 	return getNode(*map, x, y);
 }
 
-bool isBlocked(Map& map, int x, int y) {
-	return getNode(map, x, y)->blocked;
+//atomic, since neighboring cells share a word and the map is filled in parallel
+void setBlocked(Map& map, NodeId node, int blocked) {
+	if (map.procedural != NULL) {
+		overrideBlocked(map, node, blocked);
+		return;
+	}
+	if (map.tiles != NULL) pinTile(map, node);
+	uint64_t bit = ((uint64_t)1) << (node & 63);
+	if (blocked) __atomic_fetch_or(&(map.blocked[node >> 6]), bit, __ATOMIC_RELAXED);
+	else __atomic_fetch_and(&(map.blocked[node >> 6]), ~bit, __ATOMIC_RELAXED);
+}
+
+coord coordOf(Map& map, NodeId node) {
+	if (map.layout == LAYOUT_MORTON) {
+		coord ret = {(int)compactBits(((uint64_t)node) >> 1), (int)compactBits(node)};
+		return ret;
+	}
+	node -= map.origin;
+	if (map.strideShift >= 0) {
+		//the ring above a padded map has negative offsets, shifting rounds those down to row -1
+		coord ret = {(int)(node >> map.strideShift), (int)(node & (map.stride - 1))};
+		return ret;
+	}
+	coord ret = {(int)(node / map.stride), (int)(node % map.stride)};
+	return ret;
+}
+
+int oppositeDir(int dir) {
+	return dir ^ 1;
+}
+
+const char* layoutName(int layout) {
+	if (layout == LAYOUT_PADDED) return "padded";
+	if (layout == LAYOUT_MORTON) return "morton";
+	return "plain";
 }
-bool isBlocked(Node* node) {
-	return node->blocked;
+int layoutNamed(const char* name) {
+	if (strcmp(name, "padded") == 0) return LAYOUT_PADDED;
+	if (strcmp(name, "morton") == 0) return LAYOUT_MORTON;
+	if (strcmp(name, "plain") == 0) return LAYOUT_PLAIN;
+	return -1;
 }
 
+NodeId parentOf(Map& map, NodeId node) {
+	int dir = stateParent(loadState(map, node));
+	if (dir == DIR_NONE) return NO_NODE;
+	return neighborOf(map, node, dir);
+}
 
-int indexOf(Map& map, int x, int y) {
-	return x * map.cols + y;
+//registers a new search instance starting at origin, returning the id it marks cells with
+int claimOwner(Map* map, coord origin) {
+	int id = __sync_add_and_fetch(&(map->numOwners), 1);
+	if (id > MAX_OWNERS) {
+		printf("Warn: more than %d search instances on one map\n", MAX_OWNERS);
+		exit(1);
+	}
+	map->origins[id] = origin;
+	return id;
 }
 
-bool validX(Map& map, int x) {
-	return x >=0 && x < map.cols;
+static void setEpoch(Map& map, int epoch) {
+	map.epoch = epoch;
+	map.stamp = ((NodeState)epoch) << STATE_EPOCH_SHIFT;
+	map.unvisited = UNVISITED_STATE | map.stamp;
 }
-bool validY(Map& map, int y) {
-	return y >=0 && y < map.rows;
+
+//first writer of a page installs it, a thread that loses the race frees its own copy. The
+// page's fringe slots follow its state words
+NodeState* allocateStatePage(Map& map, NodeId page) {
+	NodeState* fresh = (NodeState*) calloc(STATE_PAGE_CELLS, sizeof(NodeState) + sizeof(int));
+	NodeState* installed = NULL;
+	if (!__atomic_compare_exchange_n(&(map.statePages[page]), &installed, fresh, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		free(fresh);
+		return installed;
+	}
+	map.pagesUsed[__atomic_fetch_add(&(map.numPagesUsed), 1, __ATOMIC_RELAXED)] = page;
+	return fresh;
 }
 
+static void dropStatePages(Map& map) {
+	for (NodeId i = 0; i < map.numPagesUsed; i++) {
+		free(map.statePages[map.pagesUsed[i]]);
+		map.statePages[map.pagesUsed[i]] = NULL;
+	}
+	map.numPagesUsed = 0;
+}
+
+//forgets everything previous searches wrote into the map, leaving obstacles untouched.
+//Normally O(1): only once every MAX_EPOCH searches, when the epoch wraps, are the state
+// words actually cleared. A paged map drops its pages instead, which costs what the last
+// search explored
+void newSearch(Map& map) {
+	if (map.stateMode == STATE_PAGED) dropStatePages(map);
+	if (map.epoch == MAX_EPOCH) {
+		if (map.stateMode == STATE_DENSE) {
+			#pragma omp parallel for
+			for (NodeId i = 0; i < map.cells; i++) {
+				map.state[i] = 0; //epoch 0 is never current
+			}
+		}
+		setEpoch(map, 1);
+	}
+	else {
+		setEpoch(map, map.epoch + 1);
+	}
+	map.numOwners = 0;
+}
+
+NodeId bitsetWords(Map& map) {
+	return (map.cells + 63) / 64;
+}
+
+NodeId statePageCount(Map& map) {
+	return (map.cells + STATE_PAGE_CELLS - 1) >> STATE_PAGE_SHIFT;
+}
+
+//per map cell, so a padded map's ring and stride count against it. A paged map counts the
+// pages the last search allocated, and its page table, a procedural one no bitset, and a
+// tiled one only its resident tiles
+double bytesPerNode(Map& map) {
+	double stateBytes = ((double)map.cells) * (sizeof(NodeState) + sizeof(int));
+	if (map.stateMode == STATE_PAGED) {
+		stateBytes = ((double)map.numPagesUsed) * STATE_PAGE_CELLS * (sizeof(NodeState) + sizeof(int)) +
+			((double)statePageCount(map)) * (sizeof(NodeState*) + sizeof(NodeId));
+	}
+	double obstacleBytes = map.procedural != NULL ? 0 : map.cells / 8.0;
+	if (map.tiles != NULL) obstacleBytes = ((double)map.tiles->residentTiles) * TILED_TILE_BYTES;
+	return (stateBytes + obstacleBytes) / (((double)map.rows) * map.cols);
+}
+
+
 int littleToBigI(MetaMap* mmap, coord little) {
 	coord bigCoord = littleToBig(mmap, little);
 	return indexOf(*(mmap->real), bigCoord.x, bigCoord.y);
@@ -64,8 +197,10 @@ coord littleToBig(MetaMap* mmap, coord little) {
 }
 
 coord bigToLittle(MetaMap* mmap, coord big) {
-	int x = big.x / mmap->factor;
-	int y = big.y / mmap->factor;
+	//when the side length isn't a multiple of the high level side length, the
+	// leftover cells at the far edges belong to the last high level square
+	int x = min(big.x / mmap->factor, mmap->meta->rows - 1);
+	int y = min(big.y / mmap->factor, mmap->meta->cols - 1);
 	coord ret = {x, y};
 	return ret;
 }
@@ -74,8 +209,10 @@ int bigToLittleI(MetaMap* mmap, coord big) {
 	return indexOf(*(mmap->meta), littleCoord.x, littleCoord.y);
 }
 
+//locks are numbered by square, whatever the layout of the high level map
 omp_lock_t * lockFor(MetaMap* mmap, coord globalCoord) {
-	int lockIndex = bigToLittleI(mmap, globalCoord);
+	coord square = bigToLittle(mmap, globalCoord);
+	int lockIndex = square.x * mmap->meta->cols + square.y;
 	return &(mmap->locks[lockIndex]);
 }
 
@@ -103,83 +240,213 @@ omp_lock_t * lockFor(MetaMap* mmap, coord globalCoord) {
  */
 
 MetaMap* buildMap(MapParams params, int seed, int maxHighLevelSideLen) {
-	srand(seed);
-
 	//make the real map:
 	struct Map* map = initializeMap(params);
 	struct Bounds* bounds = initializeBounds(params);
+	bounds->key = mixKey(seed, 0);
+	//quadrants become omp tasks, the result is the same for any number of threads
+	#pragma omp parallel
+	#pragma omp single
 	obsFiller(*map, *bounds);
 
-	int sum = 0;
-	for (int i = 0; i < params.sidelength; i++) {
-		for (int j = 0; j < params.sidelength; j++) {
-			sum += isBlocked(*map, i, j);
-		}
+	//make the high level map:
+	if (maxHighLevelSideLen > params.sidelength) maxHighLevelSideLen = params.sidelength;
+	Map* highLevel = highLevelMap(*map, maxHighLevelSideLen, highLevelCutoff(*map));
+
+	return assembleMetaMap(map, highLevel);
+}
+
+//the occupancy above which a high level square counts as blocked
+double highLevelCutoff(Map& map) {
+	long long sum = 0;
+	if (map.procedural != NULL) {
+		sum = map.procedural->blockedCells;
 	}
+	else {
+		NodeId words = bitsetWords(map);
+		#pragma omp parallel for reduction(+:sum)
+		for (NodeId w = 0; w < words; w++) {
+			sum += __builtin_popcountll(map.blocked[w]);
+		}
 
-	double average = ((double)sum) / (params.sidelength*params.sidelength);
+		//the cells off the map are all blocked, they don't count
+		sum -= map.cells - ((NodeId)map.rows) * map.cols;
+	}
+	double average = ((double)sum) / ((double)map.rows*map.cols);
 
 	//IMPORTANT: if we don't make the threshold higher than the average, then the concentration
 	// in the HL map will be about 0.5, which is rather high (resulting in fewer paths)
-	double cutoff = average * 1.2;//max(0.03, average*1.1);
-
-	//make the high level map:
-	if (maxHighLevelSideLen > params.sidelength) maxHighLevelSideLen = params.sidelength;
-	Map* highLevel = highLevelMap(*map, maxHighLevelSideLen, cutoff);
+	return average * 1.2;//max(0.03, average*1.1);
+}
 
+//pairs a real map with its high level map, creating one lock per high level square
+MetaMap* assembleMetaMap(Map* real, Map* meta) {
 	//create the locks:
-	int numLocks = maxHighLevelSideLen * maxHighLevelSideLen;
+	int numLocks = meta->rows * meta->cols;
 	omp_lock_t * locks = new omp_lock_t[numLocks];
 	for (int i = 0; i < numLocks; i++) {
 		omp_init_lock(&(locks[i]));
 	}
 
 	MetaMap* mmap = (MetaMap*)malloc(sizeof(MetaMap));
-	mmap->factor = map->cols / highLevel->cols;
-	mmap->meta = highLevel;
-	mmap->real = map;
+	mmap->factor = real->cols / meta->cols;
+	mmap->meta = meta;
+	mmap->real = real;
 	mmap->locks = locks;
+	mmap->claimMode = CLAIM_CAS;
+	mmap->expansion = EXPAND_ALL;
+	mmap->landmarks = NULL;
 
 	return mmap;
 }
 
-Map* initializeMap(MapParams& params) {
-	int sidelength = params.sidelength;
-	double change = params.change;
-	struct Map* map = (Map*) malloc(sizeof(struct Map));
+static void blockRange(Map& map, NodeId from, NodeId to) {
+	for (NodeId n = from; n < to; n++) setBlocked(map, n, 1);
+}
+
+//blocked may point at an existing obstacle bitset (e.g. a mapped map file), otherwise
+// a clear one is allocated
+Map* allocateMap(int sidelength, double change, uint64_t* blocked) {
+	return allocateMapLayout(sidelength, change, blocked, LAYOUT_PLAIN, STATE_DENSE);
+}
+
+//the dimensions of a map and where its cells go, everything that follows from the side and
+// layout alone
+static void layOut(Map* map, int sidelength, int layout) {
 	map->rows = sidelength;
 	map->cols = sidelength;
-	map->nodes = (Node*) malloc(sidelength*sidelength * sizeof(Node));
-	for (int x = 0; x < sidelength; x++) {
-		for (int y = 0; y < sidelength; y++) {
-			int index = indexOf(*map, x, y);
-			coord nc = {x,y};
-			map->nodes[index] = Node(nc);
-		}
+	map->layout = layout;
+	if (layout == LAYOUT_PADDED) {
+		map->stride = 1;
+		while (map->stride < sidelength + 1) map->stride *= 2;
+		map->origin = map->stride;
+		map->cells = (sidelength + 2) * map->stride;
+	}
+	else if (layout == LAYOUT_MORTON) {
+		map->stride = 1;
+		while (map->stride < sidelength) map->stride *= 2;
+		map->origin = 0;
+		map->cells = map->stride * map->stride;
 	}
+	else {
+		map->stride = sidelength;
+		map->origin = 0;
+		map->cells = ((NodeId)sidelength) * sidelength;
+	}
+	map->strideShift = -1;
+	for (int s = 0; s < 63; s++) {
+		if ((((NodeId)1) << s) == map->stride) map->strideShift = s;
+	}
+}
+
+//how many ids a map of this side and layout uses, without allocating it
+NodeId layoutCells(int sidelength, int layout) {
+	Map map;
+	layOut(&map, sidelength, layout);
+	return map.cells;
+}
+
+//everything but the obstacles, blocked is left NULL for the caller to fill in or replace
+Map* allocateMapUnfilled(int sidelength, double change, int layout, int stateMode) {
+	struct Map* map = (Map*) malloc(sizeof(struct Map));
+	layOut(map, sidelength, layout);
+	map->blocked = NULL;
+	map->procedural = NULL;
+	map->tiles = NULL;
+
+	//zeroed words belong to epoch 0, which is never current, so there's nothing to initialize
+	// (and calloc can hand out untouched zero pages)
+	map->stateMode = stateMode;
+	map->state = NULL;
+	map->fringeSlots = NULL;
+	map->statePages = NULL;
+	map->pagesUsed = NULL;
+	map->numPagesUsed = 0;
+	if (stateMode == STATE_PAGED) {
+		map->statePages = (NodeState**) calloc(statePageCount(*map), sizeof(NodeState*));
+		map->pagesUsed = (NodeId*) malloc(statePageCount(*map) * sizeof(NodeId));
+	}
+	else {
+		map->state = (NodeState*) arenaCalloc(map->cells, sizeof(NodeState));
+		map->fringeSlots = (int*) arenaCalloc(map->cells, sizeof(int));
+	}
+	map->origins = (coord*) malloc((MAX_OWNERS + 1) * sizeof(coord));
+	map->numOwners = 0;
+	setEpoch(*map, 1);
 	map->percchange = change;
 	return map;
 }
 
+//an existing bitset has to have been laid out the same way
+Map* allocateMapLayout(int sidelength, double change, uint64_t* blocked, int layout, int stateMode) {
+	Map* map = allocateMapUnfilled(sidelength, change, layout, stateMode);
+	map->blocked = blocked;
+	if (blocked == NULL) {
+		map->blocked = (uint64_t*) arenaCalloc(bitsetWords(*map), sizeof(uint64_t));
+		if (layout == LAYOUT_PADDED) {
+			//the ring above, the tail of every row, which is also the ring left of the
+			// next one, and the ring below
+			blockRange(*map, 0, map->origin);
+			#pragma omp parallel for
+			for (int x = 0; x < sidelength; x++) {
+				blockRange(*map, indexOf(*map, x, sidelength), indexOf(*map, x + 1, 0));
+			}
+			blockRange(*map, indexOf(*map, sidelength, 0), map->cells);
+		}
+		if (layout == LAYOUT_MORTON) {
+			//the padding is scattered through the ids, so it's blocked by coordinate
+			int padded = map->stride;
+			#pragma omp parallel for schedule(dynamic, 64)
+			for (int x = 0; x < padded; x++) {
+				for (int y = x < sidelength ? sidelength : 0; y < padded; y++) {
+					setBlocked(*map, indexOf(*map, x, y), 1);
+				}
+			}
+		}
+	}
+	return map;
+}
+
+//ownsBlocked is false for maps whose bitset (or procedural obstacles) belongs to someone
+// else (a map file, another map)
+void freeMap(Map* map, bool ownsBlocked) {
+	if (ownsBlocked) arenaFree(map->blocked);
+	if (ownsBlocked && map->procedural != NULL) freeProcedural(map->procedural);
+	if (map->stateMode == STATE_PAGED) dropStatePages(*map);
+	free(map->statePages);
+	free(map->pagesUsed);
+	arenaFree(map->state);
+	arenaFree(map->fringeSlots);
+	free(map->origins);
+	free(map);
+}
+
+//only for maps from buildMap, whose bitsets were allocated with them
+void freeMetaMap(MetaMap* mmap) {
+	int numLocks = mmap->meta->rows * mmap->meta->cols;
+	for (int i = 0; i < numLocks; i++) {
+		omp_destroy_lock(&(mmap->locks[i]));
+	}
+	delete[] mmap->locks;
+	freeMap(mmap->real, true);
+	freeMap(mmap->meta, true);
+	free(mmap);
+}
+
+Map* initializeMap(MapParams& params) {
+	return allocateMapLayout(params.sidelength, params.change, NULL, params.layout, params.stateMode);
+}
+
 //uses pixelation to reduce the map from its current dimensions to a new, smaller dimension
 Map* highLevelMap(Map& map, int newSideLen, double occupancyThreshold) {
 	int highLevelSquares = newSideLen * newSideLen;
 	if (highLevelSquares%4  != 0)
 		printf("Warn: highLevelSquares is not a multiple of four");
-	Map* hl = (Map*) malloc(sizeof(struct Map));
-	hl->nodes = (Node*) malloc(highLevelSquares * sizeof(Node));
-	hl->rows = newSideLen;
-	hl->cols = hl->rows;
-	for (int x = 0; x < hl->cols; x++) {
-		for (int y = 0; y < hl->rows; y++) {
-			coord nc = {x,y};
-			hl->nodes[indexOf(*hl, x, y)] = Node(nc);
-		}
-	}
-	hl->percchange = 0.0; //TODO: BRENT DOESN'T KNOW WHAT THIS MEANS... so it's zero
+	Map* hl = allocateMapLayout(newSideLen, 0.0, NULL, map.layout, STATE_DENSE); //TODO: BRENT DOESN'T KNOW WHAT percchange MEANS... so it's zero
 
 	int step = map.cols/newSideLen;
 	//for each high level coordinate i,j
+	#pragma omp parallel for collapse(2) schedule(dynamic)
 	for (int i = 0; i < hl->rows; i++) {
 		for (int j = 0; j < hl->cols; j++) {
 			int sum = 0;
@@ -190,7 +457,7 @@ Map* highLevelMap(Map& map, int newSideLen, double occupancyThreshold) {
 			for (int x = xlo; x < xhi; x++) {
 				for (int y = ylo; y < yhi; y++) {
 					//TODO: assumption on the following line, that map values are all ones (occupied) or zeroes (empty)
-					sum+=getNode(map, x, y)->blocked;
+					sum+=isBlocked(map, x, y);
 				}
 			}
 			double fraction = ((double)sum)/(step*step);
@@ -199,7 +466,7 @@ Map* highLevelMap(Map& map, int newSideLen, double occupancyThreshold) {
 				value = 1;
 			}
 
-			getNode(*hl, i, j)->blocked = value;
+			setBlocked(*hl, getNode(*hl, i, j), value);
 			//setMapValue(*hl, i, j, value);
 		}
 	}
@@ -215,196 +482,231 @@ struct Bounds* initializeBounds(MapParams& params) {
 	bounds->rowlength = sidelength;
 	bounds->collength = sidelength;
 	bounds->perc = obsratio;
+	bounds->key = 0;
 
 	return bounds;
 }
 
-void obsFiller(struct Map& map, struct Bounds& bounds) {
-	//printf("\nRow: %d, Col %d, RowL %d, ColL %d\n", bounds.row, bounds.col, bounds.rowlength, bounds.collength);
+//squares with at least this many cells are filled by their own omp task
+#define TASK_CELLS (128*128)
 
+//recurses into a quadrant, as a task when it's big enough to be worth one
+static void fillQuadrant(Map& map, Bounds quadrant) {
+	if (((long long)quadrant.rowlength) * quadrant.collength >= TASK_CELLS) {
+		Map* shared = &map;
+		#pragma omp task firstprivate(quadrant)
+		obsFiller(*shared, quadrant);
+	}
+	else {
+		obsFiller(map, quadrant);
+	}
+}
 
-	if (bounds.rowlength <= 1 && bounds.collength <= 1) { //base case
-		if (bounds.row < map.rows && bounds.col < map.cols && bounds.row >=0 && bounds.col >= 0) {
-			//printf("Drawing row: %d, col %d. Percent %f\n", bounds.row, bounds.col, bounds.perc);
-			int val = genRand() < bounds.perc ? 1 : 0;
-			getNode(map, bounds.row, bounds.col)->blocked = val;
-		}
-		else {
-			return; //bounds are... out of bounds
-		}
-	} else {
-		int rowlength = bounds.rowlength / 2;
-		int collength = bounds.collength / 2;
+//the quadrants a square is split into, each with its own key and a ratio drifted from the
+// square's by up to change. Returns how many there are, up to four
+int splitBounds(Bounds& bounds, double change, Bounds* quadrants) {
+	int count = 0;
+	int rowlength = bounds.rowlength / 2;
+	int collength = bounds.collength / 2;
 
-		int rowstart;
-		int colstart;
-		int rowuse;
-		int coluse;
+	int rowstart;
+	int colstart;
+	int rowuse;
+	int coluse;
 
 //        printf("Row: %d, Col: %d, Original: %d, Halved: %d\n", bounds.row, bounds.col, bounds.sidelength, newsidelength);
 
-		//struct Bounds* upperLeft = (Bounds*) malloc(sizeof(struct Bounds));
+	//struct Bounds* upperLeft = (Bounds*) malloc(sizeof(struct Bounds));
 
-		struct Bounds upperLeft = {
-			bounds.row,
-			bounds.col,
-			rowlength,
-			collength,
-			bounds.perc + map.percchange * genRand() * genRandSign()
-		};
+	uint64_t upperLeftKey = mixKey(bounds.key, SALT_QUADRANT + 0);
+	struct Bounds upperLeft = {
+		bounds.row,
+		bounds.col,
+		rowlength,
+		collength,
+		bounds.perc + change * genRand(upperLeftKey, DRAW_CHANGE) * genRandSign(upperLeftKey, DRAW_SIGN),
+		upperLeftKey
+	};
 
 /*
-		upperLeft->rowlength = rowlength;
-		upperLeft->collength = collength;
-		upperLeft->row = bounds.row;
-		upperLeft->col = bounds.col;
-		upperLeft->perc = bounds.perc + map.percchange * genRand() * genRandSign();
-		*/
-		obsFiller(map, upperLeft);
-		//free(upperLeft);
-
-		if (bounds.collength > 1) {
-
-			colstart = bounds.col + collength;
-			if (bounds.collength % 2 != 0) {
+	upperLeft->rowlength = rowlength;
+	upperLeft->collength = collength;
+	upperLeft->row = bounds.row;
+	upperLeft->col = bounds.col;
+	upperLeft->perc = bounds.perc + change * genRand() * genRandSign();
+	*/
+	quadrants[count++] = upperLeft;
+	//free(upperLeft);
+
+	if (bounds.collength > 1) {
+
+		colstart = bounds.col + collength;
+		if (bounds.collength % 2 != 0) {
 //                if (bounds.col % 2 == 0 && collength > 1) {
 //                    coluse = collength + 2;
 //                } else
 
-				if (bounds.collength > 2) {
-					coluse = collength + 1;
-				} else {
-					coluse = collength;
-				}
+			if (bounds.collength > 2) {
+				coluse = collength + 1;
 			} else {
 				coluse = collength;
 			}
+		} else {
+			coluse = collength;
+		}
 
-			rowstart = bounds.row;
-			rowuse = rowlength;
+		rowstart = bounds.row;
+		rowuse = rowlength;
 
 /*
-			struct Bounds* upperRight = (Bounds*) malloc(sizeof(struct Bounds));
+		struct Bounds* upperRight = (Bounds*) malloc(sizeof(struct Bounds));
 
-			upperRight->rowlength = rowuse;
-			upperRight->collength = coluse;
-			upperRight->row = rowstart;
-			upperRight->col = colstart;
+		upperRight->rowlength = rowuse;
+		upperRight->collength = coluse;
+		upperRight->row = rowstart;
+		upperRight->col = colstart;
 */
-			struct Bounds upperRight = {
-				rowstart,
-				colstart,
-				rowuse,
-				coluse,
-				bounds.perc+map.percchange*genRand()*genRandSign()
-			};
-
-			//upperRight->perc = bounds.perc + map.percchange * genRand() * genRandSign();
-			obsFiller(map, upperRight);
-			//free(upperRight);
+		uint64_t upperRightKey = mixKey(bounds.key, SALT_QUADRANT + 1);
+		struct Bounds upperRight = {
+			rowstart,
+			colstart,
+			rowuse,
+			coluse,
+			bounds.perc + change * genRand(upperRightKey, DRAW_CHANGE) * genRandSign(upperRightKey, DRAW_SIGN),
+			upperRightKey
+		};
 
-		}
+		//upperRight->perc = bounds.perc + change * genRand() * genRandSign();
+		quadrants[count++] = upperRight;
+		//free(upperRight);
+
+	}
 
 //        if (bounds.rowlength == 24 && bounds.collength == 24) {
 //            printf("Ready to start real deal\n");
 //        }
-		if (bounds.rowlength > 1 && bounds.collength > 1) {
+	if (bounds.rowlength > 1 && bounds.collength > 1) {
 
 //            if (bounds.rowlength == 24 && bounds.collength == 24) {
 //                printf("Ready to start real deal\n");
 //            }
-			colstart = bounds.col + collength;
-			rowstart = bounds.row + rowlength;
+		colstart = bounds.col + collength;
+		rowstart = bounds.row + rowlength;
 
-			if (bounds.collength % 2 != 0) {
+		if (bounds.collength % 2 != 0) {
 //                if (bounds.col % 2 == 0 && collength > 1) {
 //                    coluse = collength + 2;
 //                } else
 
-				if (bounds.collength > 2) {
-					//printf("Bounds incremented %d\n", collength + 1);
-					coluse = collength + 1;
-				} else {
-					coluse = collength;
-				}
+			if (bounds.collength > 2) {
+				//printf("Bounds incremented %d\n", collength + 1);
+				coluse = collength + 1;
 			} else {
 				coluse = collength;
 			}
+		} else {
+			coluse = collength;
+		}
 
-			if (bounds.rowlength % 2 != 0) {
+		if (bounds.rowlength % 2 != 0) {
 //                if (bounds.row % 2 == 0 && rowlength > 1) {
 //                    rowuse = rowlength + 2;
 //                } else
 
-				if (bounds.rowlength > 2) {
-					//printf("Bounds incremented %d\n", rowlength + 1);
-					rowuse = rowlength + 1;
-				} else {
-					rowuse = rowlength;
-				}
+			if (bounds.rowlength > 2) {
+				//printf("Bounds incremented %d\n", rowlength + 1);
+				rowuse = rowlength + 1;
 			} else {
 				rowuse = rowlength;
 			}
+		} else {
+			rowuse = rowlength;
+		}
 
 /*
-			struct Bounds* lowerRight = (Bounds*) malloc(sizeof(struct Bounds));
-			lowerRight->rowlength = rowuse;
-			lowerRight->collength = coluse;
-			lowerRight->row = rowstart;
-			lowerRight->col = colstart;
-			lowerRight->perc = bounds.perc + map.percchange * genRand() * genRandSign();
-			*/
-
-			struct Bounds lowerRight = {
-				rowstart,
-				colstart,
-				rowuse,
-				coluse,
-				bounds.perc + map.percchange * genRand() * genRandSign()
-			};
-			obsFiller(map, lowerRight);
-			//free(lowerRight);
+		struct Bounds* lowerRight = (Bounds*) malloc(sizeof(struct Bounds));
+		lowerRight->rowlength = rowuse;
+		lowerRight->collength = coluse;
+		lowerRight->row = rowstart;
+		lowerRight->col = colstart;
+		lowerRight->perc = bounds.perc + change * genRand() * genRandSign();
+		*/
 
-		}
+		uint64_t lowerRightKey = mixKey(bounds.key, SALT_QUADRANT + 2);
+		struct Bounds lowerRight = {
+			rowstart,
+			colstart,
+			rowuse,
+			coluse,
+			bounds.perc + change * genRand(lowerRightKey, DRAW_CHANGE) * genRandSign(lowerRightKey, DRAW_SIGN),
+			lowerRightKey
+		};
+		quadrants[count++] = lowerRight;
+		//free(lowerRight);
 
-		if (bounds.rowlength > 1) {
-			colstart = bounds.col;
-			coluse = collength;
+	}
 
-			rowstart = bounds.row + rowlength;
-			if (rowlength % 2 != 0) {
+	if (bounds.rowlength > 1) {
+		colstart = bounds.col;
+		coluse = collength;
+
+		rowstart = bounds.row + rowlength;
+		if (rowlength % 2 != 0) {
 //                if (bounds.row % 2 == 0 && rowlength > 1) {
 //                    rowuse = rowlength + 2;
 //                } else
 
-				if (bounds.rowlength > 2) {
-					rowuse = rowlength + 1;
-				} else {
-					rowuse = rowlength;
-				}
+			if (bounds.rowlength > 2) {
+				rowuse = rowlength + 1;
 			} else {
 				rowuse = rowlength;
 			}
+		} else {
+			rowuse = rowlength;
+		}
 /*
-			struct Bounds* lowerLeft = (Bounds*) malloc(sizeof(struct Bounds));
-			lowerLeft->rowlength = rowuse;
-			lowerLeft->collength = coluse;
-			lowerLeft->perc = bounds.perc + map.percchange * genRand() * genRandSign();
-			lowerLeft->row = rowstart;
-			lowerLeft->col = colstart;
-			*/
-
-
-			struct Bounds lowerLeft = {
-				rowstart,
-				colstart,
-				rowuse,
-				coluse,
-				bounds.perc + map.percchange * genRand() * genRandSign()
-			};
-			obsFiller(map, lowerLeft);
-			//free(lowerLeft);
+		struct Bounds* lowerLeft = (Bounds*) malloc(sizeof(struct Bounds));
+		lowerLeft->rowlength = rowuse;
+		lowerLeft->collength = coluse;
+		lowerLeft->perc = bounds.perc + change * genRand() * genRandSign();
+		lowerLeft->row = rowstart;
+		lowerLeft->col = colstart;
+		*/
+
+
+		uint64_t lowerLeftKey = mixKey(bounds.key, SALT_QUADRANT + 3);
+		struct Bounds lowerLeft = {
+			rowstart,
+			colstart,
+			rowuse,
+			coluse,
+			bounds.perc + change * genRand(lowerLeftKey, DRAW_CHANGE) * genRandSign(lowerLeftKey, DRAW_SIGN),
+			lowerLeftKey
+		};
+		quadrants[count++] = lowerLeft;
+		//free(lowerLeft);
+	}
+	return count;
+}
+
+void obsFiller(struct Map& map, struct Bounds& bounds) {
+	//printf("\nRow: %d, Col %d, RowL %d, ColL %d\n", bounds.row, bounds.col, bounds.rowlength, bounds.collength);
+
+	if (bounds.rowlength <= 1 && bounds.collength <= 1) { //base case
+		if (bounds.row < map.rows && bounds.col < map.cols && bounds.row >=0 && bounds.col >= 0) {
+			//printf("Drawing row: %d, col %d. Percent %f\n", bounds.row, bounds.col, bounds.perc);
+			//squares can overlap by a row or column at odd sizes, so only ever set bits:
+			// the cell ends up blocked if any square covering it says so, whatever the order
+			if (leafBlocked(bounds)) {
+				setBlocked(map, getNode(map, bounds.row, bounds.col), 1);
+			}
 		}
+		return; //bounds are... out of bounds
+	}
+	Bounds quadrants[4];
+	int count = splitBounds(bounds, map.percchange, quadrants);
+	for (int q = 0; q < count; q++) {
+		fillQuadrant(map, quadrants[q]);
 	}
 }
 
@@ -1,5 +1,6 @@
 #include <limits.h>
 #include <cstddef>
+#include <stdint.h>
 #include <omp.h>
 
 #ifndef NODEMAP_H
@@ -11,40 +12,179 @@ struct coord {
 };
 bool operator==(const coord& l, const coord& r);
 
+//how cells are laid out in the arrays of a map
+#define LAYOUT_PLAIN  0 //cell (x,y) at x*cols + y
+#define LAYOUT_PADDED 1 //rows padded to a power of two stride, with a ring of blocked cells
+                        // around the map, so every neighbor of a map cell has an index
+#define LAYOUT_MORTON 2 //Z-order: the bits of x and y interleaved, so cells near each other on
+                        // the map are mostly near each other in memory, whichever way a search
+                        // heads. The side is padded to a power of two, the padding blocked
+
+//how a map holds its search state
+#define STATE_DENSE 0 //a word for every cell, allocated with the map
+#define STATE_PAGED 1 //pages of STATE_PAGE_CELLS words, allocated when a search first writes
+                      // into one and dropped by newSearch, so the memory follows the area the
+                      // search explores rather than the map. A page is a 64x64 square of a
+                      // Morton map, but only a stretch of a row of the other layouts
+#define STATE_PAGE_SHIFT 12
+#define STATE_PAGE_CELLS (((NodeId)1) << STATE_PAGE_SHIFT)
+
 struct MapParams {
 	int sidelength;
 	double obsratio;
 	double change;
+	int layout; //LAYOUT_*, plain unless set
+	int stateMode; //STATE_*, dense unless set
+	int64_t tileBudget; //bytes of a loaded map's real bitset kept in memory (see
+	                    // tiledfile.h), 0 to map the whole file
 };
 
-struct Node {
-	Node(coord _coordinate) {
-		coordinate = _coordinate;
-		//default values:
-		blocked = 0;
-		cost = INT_MAX;
-		parent = NULL;
-		owner = NULL;
-	}
-	coord coordinate;
-	int blocked;
-	int cost;
-	Node* parent;
-	Node* owner;
-};
+//cells are addressed by their index into the map's arrays, coordinates are derived from it
+typedef int64_t NodeId;
+#define NO_NODE ((NodeId)-1)
+
+//direction codes, used both for stepping to a neighbor and for storing a cell's parent
+#define DIR_XPLUS  0
+#define DIR_XMINUS 1
+#define DIR_YPLUS  2
+#define DIR_YMINUS 3
+#define DIR_NONE   4
+
+//owner 0 means "unclaimed", so at most this many search instances can claim cells in one map
+#define MAX_OWNERS 65535
+
+//everything a search writes into a cell, packed into one word so it can be claimed with a
+//single compare-and-swap:
+//  bits  0-31 cost (INT_MAX if unreached)
+//  bits 32-47 owner (0 if unclaimed)
+//  bits 48-51 parent direction (DIR_*)
+//  bit     52 set while the cell waits in its owner's now/later list
+//  bits 53-63 epoch of the search that wrote the word
+typedef uint64_t NodeState;
+#define STATE_OWNER_SHIFT 32
+#define STATE_PARENT_SHIFT 48
+#define STATE_IN_FRINGE (((NodeState)1) << 52)
+#define STATE_EPOCH_SHIFT 53
+#define MAX_EPOCH 2047
 
+inline NodeState packState(int cost, int owner, int parentDir) {
+	return ((NodeState)(uint32_t)cost) |
+	       (((NodeState)owner) << STATE_OWNER_SHIFT) |
+	       (((NodeState)parentDir) << STATE_PARENT_SHIFT);
+}
+inline int stateCost(NodeState s) {
+	return (int)(uint32_t)s;
+}
+inline int stateOwner(NodeState s) {
+	return (int)((s >> STATE_OWNER_SHIFT) & 0xFFFF);
+}
+inline int stateParent(NodeState s) {
+	return (int)((s >> STATE_PARENT_SHIFT) & 0xF);
+}
+#define UNVISITED_STATE packState(INT_MAX, 0, DIR_NONE)
+
+struct Procedural;
+struct TiledFile;
+
+//structure-of-arrays grid. A cell costs 1 bit of obstacle, an 8 byte state word and a 4 byte
+// fringe slot, about 12 bytes against the 32 of a Node, or 2.6x less (see bytesPerNode)
 struct Map {
-	Node* nodes;
+	uint64_t* blocked; //obstacle bitset, one bit per cell
+	Procedural* procedural; //if set, the obstacles are computed on demand instead (see
+	                        // procedural.h) and blocked is NULL
+	TiledFile* tiles;       //if set, blocked lies in a map file read a tile at a time under a
+	                        // memory budget (see tiledfile.h)
+	NodeState* state;  //search state of every cell, see packState. NULL if paged
+	int* fringeSlots;  //slot each cell was queued in by the fringe search that holds it, only
+	                   // meaningful while its state has STATE_IN_FRINGE. NULL if paged, a
+	                   // state page keeps its cells' slots after their words
+	coord* origins;    //origins[id] is the start coordinate of search instance id
+	int numOwners;
 	int rows;
 	int cols;
 	double percchange;
+
+	//cell (x,y) is at origin + x*stride + y. Padded maps start a row in (the ring above
+	// the map), and their stride leaves at least one cell after each row, which doubles
+	// as the ring left of the next row. Morton maps ignore stride and origin (see
+	// mortonIndex), stride is just their padded side. Every cell that isn't on the map
+	// is blocked
+	int layout;
+	NodeId stride;
+	int strideShift; //log2 of stride if it's a power of two, -1 otherwise
+	NodeId origin;
+	NodeId cells;    //ids in use, map cells and ring alike
+
+	//a paged map's words are in statePages[node >> STATE_PAGE_SHIFT], NULL pages haven't
+	// been written since the last newSearch. pagesUsed lists the ones that have
+	int stateMode;
+	NodeState** statePages;
+	NodeId* pagesUsed;
+	NodeId numPagesUsed;
+
+	//state words written before the current epoch read as unvisited, so starting a new
+	// search is just bumping the epoch (see newSearch)
+	int epoch;
+	NodeState stamp;     //epoch, shifted into place for or-ing into new state words
+	NodeState unvisited; //what a stale word reads as
 };
 
+NodeState* allocateStatePage(Map& map, NodeId page);
+
+//where node's word is kept, for writing it. Allocates its page if it has none yet
+inline NodeState* stateWord(Map& map, NodeId node) {
+	if (map.stateMode == STATE_DENSE) return &(map.state[node]);
+	//acquire, so the page is seen zeroed
+	NodeState* page = __atomic_load_n(&(map.statePages[node >> STATE_PAGE_SHIFT]), __ATOMIC_ACQUIRE);
+	if (page == NULL) page = allocateStatePage(map, node >> STATE_PAGE_SHIFT);
+	return page + (node & (STATE_PAGE_CELLS - 1));
+}
+//where node's fringe slot is kept. Allocates its page if it has none yet
+inline int* fringeSlotWord(Map& map, NodeId node) {
+	if (map.stateMode == STATE_DENSE) return &(map.fringeSlots[node]);
+	NodeId offset = node & (STATE_PAGE_CELLS - 1);
+	NodeState* page = stateWord(map, node) - offset;
+	return ((int*)(page + STATE_PAGE_CELLS)) + offset;
+}
+
+//the word as stored, possibly from an earlier epoch. Only needed to compare-and-swap it.
+// A missing page reads as zeroes, epoch 0, like a fresh dense map
+inline NodeState loadRawState(Map& map, NodeId node) {
+	if (map.stateMode == STATE_DENSE) return __atomic_load_n(&(map.state[node]), __ATOMIC_RELAXED);
+	NodeState* page = __atomic_load_n(&(map.statePages[node >> STATE_PAGE_SHIFT]), __ATOMIC_ACQUIRE);
+	if (page == NULL) return 0;
+	return __atomic_load_n(&(page[node & (STATE_PAGE_CELLS - 1)]), __ATOMIC_RELAXED);
+}
+//interprets a raw word in the map's current epoch
+inline NodeState currentState(Map& map, NodeState raw) {
+	return (raw >> STATE_EPOCH_SHIFT) == (NodeState)map.epoch ? raw : map.unvisited;
+}
+inline NodeState loadState(Map& map, NodeId node) {
+	return currentState(map, loadRawState(map, node));
+}
+//s is stamped with the current epoch
+inline void storeState(Map& map, NodeId node, NodeState s) {
+	__atomic_store_n(stateWord(map, node), s | map.stamp, __ATOMIC_RELAXED);
+}
+
+//how fsearch makes sure only one instance owns a cell
+#define CLAIM_LOCK 0 //take the omp lock of the cell's high level square (lockFor)
+#define CLAIM_CAS  1 //compare-and-swap the cell's state word
+
+//how fsearch expands a node
+#define EXPAND_ALL  0 //queue all four neighbors
+#define EXPAND_JUMP 1 //jump point pruning, only queue the jump points (see expandJumps)
+
+struct Landmarks;
+
 struct MetaMap {
 	Map* real;
 	Map* meta;
 	omp_lock_t* locks;
 	int factor; // >=1
+	int claimMode; //CLAIM_LOCK or CLAIM_CAS
+	int expansion; //EXPAND_ALL or EXPAND_JUMP
+	Landmarks* landmarks; //if set, fsearch also estimates with them (see landmarks.h)
 };
 
 struct Bounds {
@@ -53,6 +193,7 @@ struct Bounds {
 	int rowlength;
 	int collength;
 	double perc;
+	uint64_t key; //identifies the square's position in the quadtree, seeds its random draws
 };
 
 omp_lock_t * lockFor(MetaMap* mmap, coord globalCoord);
@@ -62,25 +203,122 @@ coord littleToBig(MetaMap* mmap, coord little);
 int bigToLittleI(MetaMap* mmap, coord big);
 coord bigToLittle(MetaMap* mmap, coord big);
 
-bool validX(Map& map, int x);
-bool validY(Map& map, int y);
+inline bool validX(Map& map, int x) {
+	return x >=0 && x < map.cols;
+}
+inline bool validY(Map& map, int y) {
+	return y >=0 && y < map.rows;
+}
+
+//x takes the odd bits of a Morton index, y the even ones
+#define MORTON_X_BITS 0xAAAAAAAAAAAAAAAAULL
+#define MORTON_Y_BITS 0x5555555555555555ULL
+
+//the bits of v moved to the even bits of the result
+inline uint64_t spreadBits(uint32_t v) {
+	uint64_t s = v;
+	s = (s | (s << 16)) & 0x0000FFFF0000FFFFULL;
+	s = (s | (s << 8)) & 0x00FF00FF00FF00FFULL;
+	s = (s | (s << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	s = (s | (s << 2)) & 0x3333333333333333ULL;
+	s = (s | (s << 1)) & 0x5555555555555555ULL;
+	return s;
+}
+//the even bits of s, packed back together
+inline uint32_t compactBits(uint64_t s) {
+	s &= 0x5555555555555555ULL;
+	s = (s | (s >> 1)) & 0x3333333333333333ULL;
+	s = (s | (s >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+	s = (s | (s >> 4)) & 0x00FF00FF00FF00FFULL;
+	s = (s | (s >> 8)) & 0x0000FFFF0000FFFFULL;
+	s = (s | (s >> 16)) & 0x00000000FFFFFFFFULL;
+	return (uint32_t)s;
+}
+inline NodeId mortonIndex(int x, int y) {
+	return (NodeId)((spreadBits(x) << 1) | spreadBits(y));
+}
+//steps one coordinate without decoding: the other coordinate's bits are filled with ones (or
+// cleared) so the carry (or borrow) runs straight through them
+inline NodeId mortonNeighbor(NodeId node, int dir) {
+	uint64_t n = node;
+	switch (dir) {
+	case DIR_XPLUS: return (NodeId)((((n | MORTON_Y_BITS) + 1) & MORTON_X_BITS) | (n & MORTON_Y_BITS));
+	case DIR_XMINUS: return (NodeId)((((n & MORTON_X_BITS) - 1) & MORTON_X_BITS) | (n & MORTON_Y_BITS));
+	case DIR_YPLUS: return (NodeId)((((n | MORTON_X_BITS) + 1) & MORTON_Y_BITS) | (n & MORTON_X_BITS));
+	case DIR_YMINUS: return (NodeId)((((n & MORTON_Y_BITS) - 1) & MORTON_Y_BITS) | (n & MORTON_X_BITS));
+	}
+	return NO_NODE;
+}
+
+inline NodeId indexOf(Map& map, int x, int y) {
+	if (map.layout == LAYOUT_MORTON) return mortonIndex(x, y);
+	if (map.strideShift >= 0) return map.origin + (((NodeId)x) << map.strideShift) + y;
+	return map.origin + ((NodeId)x) * map.stride + y;
+}
+coord coordOf(Map& map, NodeId node);
+//no bounds checking, callers are expected to have validated the neighbor's coordinate.
+// On a padded map the neighbors of map cells are always valid ids, and blocked
+inline NodeId neighborOf(Map& map, NodeId node, int dir) {
+	if (map.layout == LAYOUT_MORTON) return mortonNeighbor(node, dir);
+	switch (dir) {
+	case DIR_XPLUS: return node + map.stride;
+	case DIR_XMINUS: return node - map.stride;
+	case DIR_YPLUS: return node + 1;
+	case DIR_YMINUS: return node - 1;
+	}
+	return NO_NODE;
+}
+int oppositeDir(int dir);
+
+//"plain", "padded" or "morton", and back. Unknown names are -1
+const char* layoutName(int layout);
+int layoutNamed(const char* name);
+
+inline NodeId getNode(Map& map, int x, int y) {
+	return indexOf(map, x, y);
+}
+NodeId getNode(Map* map, int x, int y);
+
+bool proceduralBlocked(Map& map, NodeId node);
+bool tiledBlocked(Map& map, NodeId node);
 
-int indexOf(Map& map, int x, int y);
+inline bool isBlocked(Map& map, NodeId node) {
+	if (map.procedural != NULL) return proceduralBlocked(map, node);
+	if (map.tiles != NULL) return tiledBlocked(map, node);
+	return (map.blocked[node >> 6] >> (node & 63)) & 1;
+}
+inline bool isBlocked(Map& map, int x, int y) {
+	return isBlocked(map, getNode(map, x, y));
+}
+void setBlocked(Map& map, NodeId node, int blocked);
 
-Node * getNode(Map& map, int x, int y);
-Node * getNode(Map* map, int x, int y);
+NodeId parentOf(Map& map, NodeId node);
 
-bool isBlocked(Map& map, int x, int y);
-bool isBlocked(Node* node);
+int claimOwner(Map* map, coord origin);
+void newSearch(Map& map);
+NodeId bitsetWords(Map& map);
+NodeId layoutCells(int sidelength, int layout);
+NodeId statePageCount(Map& map);
+double bytesPerNode(Map& map);
 
+Map* allocateMap(int sidelength, double change, uint64_t* blocked);
+Map* allocateMapLayout(int sidelength, double change, uint64_t* blocked, int layout, int stateMode);
+Map* allocateMapUnfilled(int sidelength, double change, int layout, int stateMode);
+void freeMap(Map* map, bool ownsBlocked);
+void freeMetaMap(MetaMap* mmap);
 Map* initializeMap(MapParams&);
 struct Bounds* initializeBounds(MapParams&);
 
+uint64_t mixKey(uint64_t key, uint64_t salt);
+int splitBounds(Bounds& bounds, double change, Bounds* quadrants);
+bool leafBlocked(Bounds& leaf);
 void obsFiller(struct Map& map, struct Bounds& bounds);
 void printMap(Map& map);
 void saveFile(Map& map, char* filename);
 
 MetaMap* buildMap(MapParams params, int seed, int maxHighLevelSideLen);
+MetaMap* assembleMetaMap(Map* real, Map* meta);
+double highLevelCutoff(Map& map);
 Map* highLevelMap(Map& map, int newSideLen, double occupancyThreshold);
 Map* occupancy(Map&);
 
@@ -0,0 +1,307 @@
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+
+#include "numa.h"
+#include "arena.h"
+
+using namespace std;
+
+//rows of every square placementReport samples
+#define REPORT_ROWS 8
+
+bool parseCpuList(const char* list, vector<int>& into) {
+	into.clear();
+	const char* p = list;
+	while (*p != '\0' && !isspace(*p)) {
+		char* end;
+		long first = strtol(p, &end, 10);
+		if (end == p || first < 0) return false;
+		long last = first;
+		if (*end == '-') {
+			p = end + 1;
+			last = strtol(p, &end, 10);
+			if (end == p || last < first) return false;
+		}
+		for (long cpu = first; cpu <= last; cpu++) into.push_back(cpu);
+		p = end;
+		if (*p == ',') {
+			p++;
+			if (*p == '\0' || isspace(*p)) return false;
+		}
+		else if (*p != '\0' && !isspace(*p)) return false;
+	}
+	while (isspace(*p)) p++;
+	return *p == '\0';
+}
+
+//nodes are numbered from 0 with no gaps, which is all Linux hands out without hotplug
+Topology readTopology() {
+	Topology topology;
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	sched_getaffinity(0, sizeof(allowed), &allowed);
+	topology.nodeOf.assign(CPU_SETSIZE, -1);
+	topology.nodes = 0;
+	for (int node = 0; ; node++) {
+		char path[64];
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+		FILE* fp = fopen(path, "r");
+		if (fp == NULL) break;
+		char line[4096];
+		vector<int> cpus;
+		if (fgets(line, sizeof(line), fp) != NULL) parseCpuList(line, cpus);
+		fclose(fp);
+		bool used = false;
+		for (size_t c = 0; c < cpus.size(); c++) {
+			if (cpus[c] >= CPU_SETSIZE || !CPU_ISSET(cpus[c], &allowed)) continue;
+			topology.nodeOf[cpus[c]] = topology.nodes;
+			topology.cpus.push_back(cpus[c]);
+			used = true;
+		}
+		//memory only nodes, or ones the process may not run on, aren't counted
+		if (used) topology.nodes++;
+	}
+	if (topology.cpus.empty()) {
+		topology.nodes = 1;
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (!CPU_ISSET(cpu, &allowed)) continue;
+			topology.nodeOf[cpu] = 0;
+			topology.cpus.push_back(cpu);
+		}
+	}
+	return topology;
+}
+
+vector<int> pinPlan(Topology& topology, int mode, vector<int>& cpuList, int threads) {
+	vector<int> plan;
+	if (mode == PIN_NONE) return plan;
+	if (mode == PIN_LIST) {
+		for (int t = 0; t < threads && !cpuList.empty(); t++) plan.push_back(cpuList[t % cpuList.size()]);
+		return plan;
+	}
+	if (mode == PIN_COMPACT) {
+		for (int t = 0; t < threads; t++) plan.push_back(topology.cpus[t % topology.cpus.size()]);
+		return plan;
+	}
+	//scatter: a contiguous block of threads per node, spread out over the node's CPUs so
+	// they share as few cores as possible
+	vector<vector<int> > byNode(topology.nodes);
+	for (size_t c = 0; c < topology.cpus.size(); c++) {
+		byNode[topology.nodeOf[topology.cpus[c]]].push_back(topology.cpus[c]);
+	}
+	for (int node = 0; node < topology.nodes; node++) {
+		int first = (int)(((int64_t)threads) * node / topology.nodes);
+		int last = (int)(((int64_t)threads) * (node + 1) / topology.nodes);
+		vector<int>& cpus = byNode[node];
+		for (int t = first; t < last; t++) {
+			plan.push_back(cpus[(((int64_t)(t - first)) * cpus.size() / (last - first)) % cpus.size()]);
+		}
+	}
+	return plan;
+}
+
+bool pinThreads(vector<int>& cpus, vector<int>& errors) {
+	errors.assign(cpus.size(), 0);
+	#pragma omp parallel num_threads(cpus.size())
+	{
+		int t = omp_get_thread_num();
+		if (cpus[t] < 0 || cpus[t] >= CPU_SETSIZE) errors[t] = EINVAL;
+		else {
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpus[t], &set);
+			errors[t] = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		}
+	}
+	for (size_t t = 0; t < errors.size(); t++) {
+		if (errors[t] != 0) return false;
+	}
+	return true;
+}
+
+vector<int> currentCpus(int threads) {
+	vector<int> cpus(threads, 0);
+	#pragma omp parallel num_threads(threads)
+	{
+		cpus[omp_get_thread_num()] = sched_getcpu();
+	}
+	return cpus;
+}
+
+//the real cells of high level square (i, j), the last squares taking the leftover cells at
+// the far edges (see bigToLittle)
+static void squareCells(MetaMap* mmap, int i, int j, int* x0, int* x1, int* y0, int* y1) {
+	Map& real = *mmap->real;
+	*x0 = i * mmap->factor;
+	*y0 = j * mmap->factor;
+	*x1 = i == mmap->meta->rows - 1 ? real.rows : min(*x0 + mmap->factor, real.rows);
+	*y1 = j == mmap->meta->cols - 1 ? real.cols : min(*y0 + mmap->factor, real.cols);
+}
+
+vector<int> squareOwners(MetaMap* mmap, coord* starts, int threads) {
+	Map& meta = *mmap->meta;
+	vector<coord> squares(threads);
+	for (int t = 0; t < threads; t++) squares[t] = bigToLittle(mmap, starts[t]);
+	vector<int> owners(meta.rows * meta.cols, 0);
+	for (int i = 0; i < meta.rows; i++) {
+		for (int j = 0; j < meta.cols; j++) {
+			int best = 0;
+			int bestDistance = INT_MAX;
+			for (int t = 0; t < threads; t++) {
+				int distance = abs(i - squares[t].x) + abs(j - squares[t].y);
+				if (distance < bestDistance) {
+					best = t;
+					bestDistance = distance;
+				}
+			}
+			owners[i * meta.cols + j] = best;
+		}
+	}
+	return owners;
+}
+
+void firstTouch(MetaMap* mmap, vector<int>& owners, int threads, bool ownsBlocked) {
+	Map& real = *mmap->real;
+	Map& meta = *mmap->meta;
+	bool touchState = real.stateMode == STATE_DENSE; //paged state is allocated by its searcher
+	//a large bitset's pages are left untouched, for the owners to fault in
+	uint64_t* placed = NULL;
+	if (ownsBlocked && real.procedural == NULL && real.tiles == NULL) {
+		placed = (uint64_t*) arenaCalloc(bitsetWords(real), sizeof(uint64_t));
+	}
+
+	#pragma omp parallel num_threads(threads)
+	{
+		int t = omp_get_thread_num();
+		for (int s = 0; s < meta.rows * meta.cols; s++) {
+			if (owners[s] != t) continue;
+			int x0, x1, y0, y1;
+			squareCells(mmap, s / meta.cols, s % meta.cols, &x0, &x1, &y0, &y1);
+			NodeId lastWord = -1;
+			for (int x = x0; x < x1; x++) {
+				for (int y = y0; y < y1; y++) {
+					NodeId n = indexOf(real, x, y);
+					//rewritten as they are, so nothing a search could see changes
+					if (touchState) {
+						__atomic_store_n(&(real.state[n]), __atomic_load_n(&(real.state[n]), __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+						__atomic_store_n(&(real.fringeSlots[n]), __atomic_load_n(&(real.fringeSlots[n]), __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+					}
+					//squares side by side can share a word at their border
+					if (placed != NULL && (n >> 6) != lastWord) {
+						lastWord = n >> 6;
+						__atomic_store_n(&(placed[lastWord]), real.blocked[lastWord], __ATOMIC_RELAXED);
+					}
+				}
+			}
+		}
+		//the words no square covers, a padded map's ring and a Morton map's padding, are
+		// still zero
+		if (placed != NULL) {
+			#pragma omp barrier
+			#pragma omp for schedule(static)
+			for (NodeId w = 0; w < bitsetWords(real); w++) {
+				if (__atomic_load_n(&(placed[w]), __ATOMIC_RELAXED) != real.blocked[w]) placed[w] = real.blocked[w];
+			}
+		}
+	}
+	if (placed != NULL) {
+		arenaFree(real.blocked);
+		real.blocked = placed;
+	}
+}
+
+//pages local to node, on another, and not allocated
+struct PageCounts {
+	int64_t local;
+	int64_t remote;
+	int64_t untouched;
+};
+
+static void countPages(vector<void*>& pages, int node, PageCounts& counts) {
+	sort(pages.begin(), pages.end());
+	pages.erase(unique(pages.begin(), pages.end()), pages.end());
+	vector<int> status(pages.size(), -ENOENT);
+	//no target nodes: move_pages only reports where each page is
+	if (!pages.empty()) syscall(SYS_move_pages, 0, pages.size(), pages.data(), NULL, status.data(), 0);
+	for (size_t p = 0; p < pages.size(); p++) {
+		if (status[p] < 0) counts.untouched++;
+		else if (status[p] == node) counts.local++;
+		else counts.remote++;
+	}
+}
+
+static void* pageOf(const void* address) {
+	static uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+	return (void*)(((uintptr_t)address) & ~(pageSize - 1));
+}
+
+void placementReport(FILE* out, MetaMap* mmap, vector<int>& owners, vector<int>& cpus, Topology& topology) {
+	Map& real = *mmap->real;
+	Map& meta = *mmap->meta;
+	int threads = cpus.size();
+	PageCounts stateTotal = {0, 0, 0};
+	PageCounts obstacleTotal = {0, 0, 0};
+	fprintf(out, "Placement (pages local/remote/untouched, sampled from %d rows of every square):\n", REPORT_ROWS);
+	for (int t = 0; t < threads; t++) {
+		vector<void*> statePages, obstaclePages;
+		vector<NodeId> missingPages; //of a paged map's state, that were never allocated
+		PageCounts state = {0, 0, 0};
+		PageCounts obstacles = {0, 0, 0};
+		for (int s = 0; s < meta.rows * meta.cols; s++) {
+			if (owners[s] != t) continue;
+			int x0, x1, y0, y1;
+			squareCells(mmap, s / meta.cols, s % meta.cols, &x0, &x1, &y0, &y1);
+			int step = max(1, (x1 - x0) / REPORT_ROWS);
+			for (int x = x0; x < x1; x += step) {
+				//every cell of the row, since a padded or Morton row can cross several pages.
+				// Consecutive cells mostly share them, so only a change of page is kept
+				void* lastState = NULL;
+				void* lastObstacles = NULL;
+				int64_t lastMissing = -1;
+				for (int y = y0; y < y1; y++) {
+					NodeId n = indexOf(real, x, y);
+					void* page;
+					if (real.stateMode == STATE_DENSE) page = pageOf(&(real.state[n]));
+					else if (real.statePages[n >> STATE_PAGE_SHIFT] == NULL) page = NULL;
+					else page = pageOf(real.statePages[n >> STATE_PAGE_SHIFT] + (n & (STATE_PAGE_CELLS - 1)));
+					if (page == NULL) {
+						if ((n >> STATE_PAGE_SHIFT) != lastMissing) missingPages.push_back(n >> STATE_PAGE_SHIFT);
+						lastMissing = n >> STATE_PAGE_SHIFT;
+					}
+					else if (page != lastState) statePages.push_back(page);
+					if (page != NULL) lastState = page;
+					if (real.blocked != NULL) {
+						page = pageOf(&(real.blocked[n >> 6]));
+						if (page != lastObstacles) obstaclePages.push_back(page);
+						lastObstacles = page;
+					}
+				}
+			}
+		}
+		sort(missingPages.begin(), missingPages.end());
+		state.untouched = unique(missingPages.begin(), missingPages.end()) - missingPages.begin();
+		int node = cpus[t] < (int)topology.nodeOf.size() ? topology.nodeOf[cpus[t]] : -1;
+		countPages(statePages, node, state);
+		countPages(obstaclePages, node, obstacles);
+		fprintf(out, "  thread %d cpu %d node %d: state %lld/%lld/%lld, obstacles %lld/%lld/%lld\n", t, cpus[t], node,
+			(long long)state.local, (long long)state.remote, (long long)state.untouched,
+			(long long)obstacles.local, (long long)obstacles.remote, (long long)obstacles.untouched);
+		stateTotal.local += state.local;
+		stateTotal.remote += state.remote;
+		stateTotal.untouched += state.untouched;
+		obstacleTotal.local += obstacles.local;
+		obstacleTotal.remote += obstacles.remote;
+		obstacleTotal.untouched += obstacles.untouched;
+	}
+	fprintf(out, "  total: state %lld/%lld/%lld, obstacles %lld/%lld/%lld\n",
+		(long long)stateTotal.local, (long long)stateTotal.remote, (long long)stateTotal.untouched,
+		(long long)obstacleTotal.local, (long long)obstacleTotal.remote, (long long)obstacleTotal.untouched);
+	fflush(out);
+}
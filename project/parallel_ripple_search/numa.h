@@ -0,0 +1,63 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "nodemap.h"
+
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <vector>
+
+using namespace std;
+
+//placing prs's threads and the memory they search on the same NUMA node. Thread i starts
+// on segment i (see searchSegments), so pinning decides which node searches which stretch
+// of the path, and first touching the map from those threads puts every high level
+// square's pages on the node of the thread whose segment starts nearest to it.
+//The topology comes from /sys/devices/system/node, without libnuma: a machine without it
+// is one node holding every CPU the process may run on
+
+//how threads are pinned to CPUs
+#define PIN_NONE    0 //left to the scheduler
+#define PIN_COMPACT 1 //each node's CPUs filled before the next node's, so as few nodes as
+                      // possible are used
+#define PIN_SCATTER 2 //the same number of threads on every node, spread over its CPUs
+#define PIN_LIST    3 //an explicit list of CPUs, thread i on the i-th
+//either way consecutive threads, so neighboring segments, share a node where they can
+
+struct Topology {
+	int nodes;
+	vector<int> cpus;   //the CPUs the process may run on, node by node
+	vector<int> nodeOf; //by CPU number, -1 for CPUs the process can't use
+};
+
+Topology readTopology();
+//"0-3,8,10-11" into the CPU numbers, in order. False if list isn't one, such as "0-"
+// or "3-1" (trailing whitespace, like sysfs's newline, is fine)
+bool parseCpuList(const char* list, vector<int>& into);
+
+//the CPU of each of threads threads. cpuList is only used by PIN_LIST, and is repeated if
+// it's shorter than threads
+vector<int> pinPlan(Topology& topology, int mode, vector<int>& cpuList, int threads);
+//pins thread i of an omp team of cpus.size() threads to cpus[i]. The pinning sticks as long
+// as later parallel regions use the same number of threads, which reuse the same threads.
+//errors gets pthread_setaffinity_np's result for each thread, false if any failed
+bool pinThreads(vector<int>& cpus, vector<int>& errors);
+//where each thread of a team of threads runs right now, for threads that aren't pinned
+vector<int> currentCpus(int threads);
+
+//which thread's memory each high level square is: the one whose start, of the threads
+// segment starts, is nearest to it. Indexed by row * cols + col of the high level map
+vector<int> squareOwners(MetaMap* mmap, coord* starts, int threads);
+
+//writes the dense state words of every square, and copies the real bitset, from the
+// square's owner, so their pages are allocated on its node. The bitset is only copied if
+// the map owns it: a map file's pages belong to the page cache, and a procedural or tiled
+// map has none to place. Has to run before any search writes into the map
+void firstTouch(MetaMap* mmap, vector<int>& owners, int threads, bool ownsBlocked);
+
+//how many pages of each thread's squares, state and bitset, are on the thread's node, on
+// another, or not allocated yet, sampled from every page of a few rows of every square
+void placementReport(FILE* out, MetaMap* mmap, vector<int>& owners, vector<int>& cpus, Topology& topology);
+
+#endif
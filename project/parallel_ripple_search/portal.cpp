@@ -0,0 +1,294 @@
+#include <queue>
+#include <vector>
+#include <algorithm>
+
+#include "portal.h"
+#include "fringesearch.h"
+
+//the cells of one cluster, [xlo, xhi) x [ylo, yhi). The last row and column of clusters
+// take the leftover cells, like bigToLittle
+struct ClusterBounds {
+	int xlo, xhi;
+	int ylo, yhi;
+};
+
+static ClusterBounds boundsOf(PortalGraph* graph, Map& real, int cluster) {
+	int cx = cluster / graph->clusterCols;
+	int cy = cluster % graph->clusterCols;
+	ClusterBounds b;
+	b.xlo = cx * graph->factor;
+	b.xhi = cx == graph->clusterRows - 1 ? real.rows : b.xlo + graph->factor;
+	b.ylo = cy * graph->factor;
+	b.yhi = cy == graph->clusterCols - 1 ? real.cols : b.ylo + graph->factor;
+	return b;
+}
+
+static int clusterOf(PortalGraph* graph, coord c) {
+	int cx = min(c.x / graph->factor, graph->clusterRows - 1);
+	int cy = min(c.y / graph->factor, graph->clusterCols - 1);
+	return cx * graph->clusterCols + cy;
+}
+
+typedef pair<NodeId, NodeId> PortalPair;
+
+//walks length cells from first along step, pairing each with its neighbor across the
+// border, and adds the portal pairs of every entrance found
+static void scanBorder(Map& real, coord first, coord step, coord across, int length, vector<PortalPair>& pairs) {
+	int runStart = -1;
+	for (int i = 0; i <= length; i++) {
+		bool open = false;
+		coord a = {first.x + i * step.x, first.y + i * step.y};
+		if (i < length) {
+			open = !isBlocked(real, a.x, a.y) && !isBlocked(real, a.x + across.x, a.y + across.y);
+		}
+		if (open && runStart == -1) runStart = i;
+		if (open || runStart == -1) continue;
+
+		int runLength = i - runStart;
+		int ends[2] = {runStart, i - 1};
+		int numEnds = 2;
+		if (runLength < PORTAL_SPLIT_LENGTH) {
+			ends[0] = runStart + runLength / 2;
+			numEnds = 1;
+		}
+		for (int e = 0; e < numEnds; e++) {
+			coord p = {first.x + ends[e] * step.x, first.y + ends[e] * step.y};
+			pairs.push_back(PortalPair(getNode(real, p.x, p.y), getNode(real, p.x + across.x, p.y + across.y)));
+		}
+		runStart = -1;
+	}
+}
+
+//breadth first search from origin that stays inside the cluster. dist is indexed by the
+// cell's offset in the cluster, -1 where it wasn't reached
+static void clusterDistances(Map& real, ClusterBounds& b, coord origin, vector<int>& dist, vector<coord>& queue) {
+	int height = b.yhi - b.ylo;
+	dist.assign((b.xhi - b.xlo) * height, -1);
+	queue.clear();
+	if (isBlocked(real, origin.x, origin.y)) return;
+	dist[(origin.x - b.xlo) * height + (origin.y - b.ylo)] = 0;
+	queue.push_back(origin);
+	for (size_t head = 0; head < queue.size(); head++) {
+		coord c = queue[head];
+		int d = dist[(c.x - b.xlo) * height + (c.y - b.ylo)];
+		int x[] = {c.x+1, c.x-1, c.x, c.x  };
+		int y[] = {c.y,   c.y, c.y+1, c.y-1};
+		for (int dir = 0; dir < 4; dir++) {
+			if (x[dir] < b.xlo || x[dir] >= b.xhi || y[dir] < b.ylo || y[dir] >= b.yhi) continue;
+			int offset = (x[dir] - b.xlo) * height + (y[dir] - b.ylo);
+			if (dist[offset] != -1 || isBlocked(real, x[dir], y[dir])) continue;
+			dist[offset] = d + 1;
+			coord next = {x[dir], y[dir]};
+			queue.push_back(next);
+		}
+	}
+}
+
+static int distanceTo(ClusterBounds& b, vector<int>& dist, coord c) {
+	return dist[(c.x - b.xlo) * (b.yhi - b.ylo) + (c.y - b.ylo)];
+}
+
+static int portalId(PortalGraph* graph, int cluster, NodeId cell) {
+	NodeId* begin = graph->cells + graph->clusterStart[cluster];
+	NodeId* end = graph->cells + graph->clusterStart[cluster + 1];
+	return lower_bound(begin, end, cell) - graph->cells;
+}
+
+PortalGraph* buildPortalGraph(MetaMap* mmap) {
+	Map& real = *mmap->real;
+	PortalGraph* graph = (PortalGraph*)malloc(sizeof(PortalGraph));
+	graph->factor = mmap->factor;
+	graph->clusterRows = mmap->meta->rows;
+	graph->clusterCols = mmap->meta->cols;
+	int clusters = graph->clusterRows * graph->clusterCols;
+
+	//every cluster finds the entrances on its far x and far y borders
+	vector<vector<PortalPair> > pairs(clusters);
+	#pragma omp parallel for schedule(dynamic)
+	for (int k = 0; k < clusters; k++) {
+		ClusterBounds b = boundsOf(graph, real, k);
+		if (b.xhi < real.rows) {
+			coord first = {b.xhi - 1, b.ylo};
+			coord step = {0, 1};
+			coord across = {1, 0};
+			scanBorder(real, first, step, across, b.yhi - b.ylo, pairs[k]);
+		}
+		if (b.yhi < real.cols) {
+			coord first = {b.xlo, b.yhi - 1};
+			coord step = {1, 0};
+			coord across = {0, 1};
+			scanBorder(real, first, step, across, b.xhi - b.xlo, pairs[k]);
+		}
+	}
+
+	//a cell can be a portal of more than one entrance (at a cluster's corner)
+	vector<vector<NodeId> > members(clusters);
+	for (int k = 0; k < clusters; k++) {
+		for (size_t p = 0; p < pairs[k].size(); p++) {
+			members[k].push_back(pairs[k][p].first);
+			members[clusterOf(graph, coordOf(real, pairs[k][p].second))].push_back(pairs[k][p].second);
+		}
+	}
+	graph->clusterStart = (int*)malloc((clusters + 1) * sizeof(int));
+	graph->clusterStart[0] = 0;
+	for (int k = 0; k < clusters; k++) {
+		sort(members[k].begin(), members[k].end());
+		members[k].erase(unique(members[k].begin(), members[k].end()), members[k].end());
+		graph->clusterStart[k + 1] = graph->clusterStart[k] + members[k].size();
+	}
+	graph->count = graph->clusterStart[clusters];
+	graph->cells = (NodeId*)malloc(graph->count * sizeof(NodeId));
+	graph->coords = (coord*)malloc(graph->count * sizeof(coord));
+	for (int k = 0; k < clusters; k++) {
+		for (size_t m = 0; m < members[k].size(); m++) {
+			int id = graph->clusterStart[k] + m;
+			graph->cells[id] = members[k][m];
+			graph->coords[id] = coordOf(real, members[k][m]);
+		}
+	}
+
+	//edges as (to, cost). The steps across borders first, then what each cluster's search adds
+	vector<vector<pair<int, int> > > adjacent(graph->count);
+	for (int k = 0; k < clusters; k++) {
+		for (size_t p = 0; p < pairs[k].size(); p++) {
+			int a = portalId(graph, k, pairs[k][p].first);
+			int b = portalId(graph, clusterOf(graph, coordOf(real, pairs[k][p].second)), pairs[k][p].second);
+			adjacent[a].push_back(make_pair(b, 1));
+			adjacent[b].push_back(make_pair(a, 1));
+		}
+	}
+	#pragma omp parallel for schedule(dynamic)
+	for (int k = 0; k < clusters; k++) {
+		ClusterBounds b = boundsOf(graph, real, k);
+		vector<int> dist;
+		vector<coord> queue;
+		for (int i = graph->clusterStart[k]; i < graph->clusterStart[k + 1]; i++) {
+			clusterDistances(real, b, graph->coords[i], dist, queue);
+			for (int j = graph->clusterStart[k]; j < graph->clusterStart[k + 1]; j++) {
+				int d = distanceTo(b, dist, graph->coords[j]);
+				if (j != i && d > 0) adjacent[i].push_back(make_pair(j, d));
+			}
+		}
+	}
+
+	graph->edgeStart = (int64_t*)malloc((graph->count + 1) * sizeof(int64_t));
+	graph->edgeStart[0] = 0;
+	for (int i = 0; i < graph->count; i++) {
+		graph->edgeStart[i + 1] = graph->edgeStart[i] + adjacent[i].size();
+	}
+	graph->edgeTo = (int32_t*)malloc(graph->edgeStart[graph->count] * sizeof(int32_t));
+	graph->edgeCost = (int*)malloc(graph->edgeStart[graph->count] * sizeof(int));
+	#pragma omp parallel for
+	for (int i = 0; i < graph->count; i++) {
+		for (size_t e = 0; e < adjacent[i].size(); e++) {
+			graph->edgeTo[graph->edgeStart[i] + e] = adjacent[i][e].first;
+			graph->edgeCost[graph->edgeStart[i] + e] = adjacent[i][e].second;
+		}
+	}
+	return graph;
+}
+
+void freePortalGraph(PortalGraph* graph) {
+	free(graph->coords);
+	free(graph->cells);
+	free(graph->clusterStart);
+	free(graph->edgeStart);
+	free(graph->edgeTo);
+	free(graph->edgeCost);
+	free(graph);
+}
+
+struct PortalEntry {
+	int f;
+	int g;
+	int node;
+};
+
+//lowest f first, ties to the deepest node
+struct PortalOrder {
+	bool operator()(const PortalEntry& a, const PortalEntry& b) const {
+		if (a.f != b.f) return a.f > b.f;
+		return a.g < b.g;
+	}
+};
+
+list<coord>* portalSearch(PortalGraph* graph, Map& real, coord start, coord goal, vector<int>* costs) {
+	if (isBlocked(real, start.x, start.y) || isBlocked(real, goal.x, goal.y)) return NULL;
+	//start and goal join the graph as two extra nodes, linked to the portals of their clusters
+	int startNode = graph->count;
+	int goalNode = graph->count + 1;
+	int startCluster = clusterOf(graph, start);
+	int goalCluster = clusterOf(graph, goal);
+
+	vector<int> dist;
+	vector<coord> queue;
+	vector<pair<int, int> > startEdges;
+	ClusterBounds sb = boundsOf(graph, real, startCluster);
+	clusterDistances(real, sb, start, dist, queue);
+	for (int i = graph->clusterStart[startCluster]; i < graph->clusterStart[startCluster + 1]; i++) {
+		int d = distanceTo(sb, dist, graph->coords[i]);
+		if (d >= 0) startEdges.push_back(make_pair(i, d));
+	}
+	if (startCluster == goalCluster && distanceTo(sb, dist, goal) >= 0) {
+		startEdges.push_back(make_pair(goalNode, distanceTo(sb, dist, goal)));
+	}
+
+	//the grid is undirected, so the distances from the goal are the distances to it
+	int goalFirst = graph->clusterStart[goalCluster];
+	vector<int> toGoal(graph->clusterStart[goalCluster + 1] - goalFirst);
+	ClusterBounds gb = boundsOf(graph, real, goalCluster);
+	clusterDistances(real, gb, goal, dist, queue);
+	for (size_t i = 0; i < toGoal.size(); i++) {
+		toGoal[i] = distanceTo(gb, dist, graph->coords[goalFirst + i]);
+	}
+
+	vector<int> cost(graph->count + 2, INT_MAX);
+	vector<int> parent(graph->count + 2, -1);
+	priority_queue<PortalEntry, vector<PortalEntry>, PortalOrder> open;
+	cost[startNode] = 0;
+	PortalEntry first = {manhattan(start, goal), 0, startNode};
+	open.push(first);
+	while (!open.empty()) {
+		PortalEntry top = open.top();
+		open.pop();
+		if (top.g > cost[top.node]) continue;
+		if (top.node == goalNode) break;
+
+		vector<pair<int, int> > edges;
+		if (top.node == startNode) {
+			edges = startEdges;
+		}
+		else {
+			for (int64_t e = graph->edgeStart[top.node]; e < graph->edgeStart[top.node + 1]; e++) {
+				edges.push_back(make_pair(graph->edgeTo[e], graph->edgeCost[e]));
+			}
+			int g = top.node - goalFirst;
+			if (g >= 0 && g < (int)toGoal.size() && toGoal[g] >= 0) {
+				edges.push_back(make_pair(goalNode, toGoal[g]));
+			}
+		}
+		for (size_t e = 0; e < edges.size(); e++) {
+			int next = edges[e].first;
+			int g = top.g + edges[e].second;
+			if (g >= cost[next]) continue;
+			cost[next] = g;
+			parent[next] = top.node;
+			coord at = next == goalNode ? goal : graph->coords[next];
+			PortalEntry entry = {g + manhattan(at, goal), g, next};
+			open.push(entry);
+		}
+	}
+	if (cost[goalNode] == INT_MAX) return NULL;
+
+	list<coord>* path = new list<coord>();
+	list<int> pathCosts;
+	for (int n = goalNode; n != -1; n = parent[n]) {
+		coord at = n == goalNode ? goal : (n == startNode ? start : graph->coords[n]);
+		//start or goal can be a portal themselves
+		if (!path->empty() && path->front() == at) continue;
+		path->push_front(at);
+		pathCosts.push_front(cost[n]);
+	}
+	if (costs != NULL) costs->assign(pathCosts.begin(), pathCosts.end());
+	return path;
+}
@@ -0,0 +1,48 @@
+#include <stdint.h>
+
+#include "nodemap.h"
+
+#ifndef PORTAL_H
+#define PORTAL_H
+
+#include <list>
+#include <vector>
+
+using namespace std;
+
+//HPA* style abstraction of the real map, an alternative to the pixelated high level map.
+// The clusters are the high level squares. Wherever the cells on both sides of a border
+// between two clusters are free, they form an entrance, and its portals are the cell
+// pairs in the middle of the entrance (or at its two ends if it's long). Portals of one
+// cluster are linked by their true distance inside the cluster, and each portal pair by
+// the one step across the border. Unlike the high level map, a path in this graph
+// always exists on the real map, and a query finds one exactly when the real map has one
+
+//entrances at least this long get a portal pair at each end instead of one in the middle
+#define PORTAL_SPLIT_LENGTH 6
+
+struct PortalGraph {
+	int count;
+	coord* coords;       //cell of each portal
+	NodeId* cells;       //the same cells as ids, ascending within each cluster
+	int* clusterStart;   //portals of cluster k are clusterStart[k]..clusterStart[k+1]
+	int64_t* edgeStart;  //edges of portal i are edgeTo[edgeStart[i]..edgeStart[i+1])
+	int32_t* edgeTo;
+	int* edgeCost;
+	int factor;          //cluster side, as in the MetaMap
+	int clusterRows;
+	int clusterCols;
+};
+
+//intra cluster distances are computed in parallel, one cluster per task
+PortalGraph* buildPortalGraph(MetaMap* mmap);
+void freePortalGraph(PortalGraph* graph);
+
+//the portals a path from start to goal crosses, with start first and goal last, or NULL
+// if there is no path. Paths only cross borders at portals, so they can be a little longer
+// than the shortest one (well under 1% on random maps). costs, if given, gets the path's
+// cost up to each of them.
+//Only reads the map's obstacles, so any number of threads can query at once
+list<coord>* portalSearch(PortalGraph* graph, Map& real, coord start, coord goal, vector<int>* costs);
+
+#endif
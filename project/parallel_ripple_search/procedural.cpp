@@ -0,0 +1,277 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "procedural.h"
+
+using namespace std;
+
+//rows of the real map each task of the high level pass computes at once
+#define STRIP_ROWS 64
+
+//the cells x0 <= x < x1, y0 <= y < y1
+struct Rect {
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+};
+
+static uint64_t nextStamp = 0;
+
+static uint64_t newStamp() {
+	return __atomic_add_fetch(&nextStamp, 1, __ATOMIC_RELAXED);
+}
+
+static int levelsBelow(int length) {
+	return length > 1 ? 64 - __builtin_clzll(length) : 1;
+}
+
+//sets the bits of local, rect's cells row by row, that obsFiller would block. Only descends
+// into the squares overlapping rect, which has to lie on the map
+static void fillRect(Procedural* proc, Bounds& bounds, Rect& rect, uint64_t* local) {
+	//at odd sizes a quadrant can reach a row or column past its square (see splitBounds),
+	// and its own quadrants one past that, so a square's cells lie within a margin of one
+	// per level below it
+	if (bounds.row >= rect.x1 || bounds.row + bounds.rowlength + levelsBelow(bounds.rowlength) <= rect.x0 ||
+	    bounds.col >= rect.y1 || bounds.col + bounds.collength + levelsBelow(bounds.collength) <= rect.y0) return;
+
+	if (bounds.rowlength <= 1 && bounds.collength <= 1) {
+		if (bounds.row < rect.x0 || bounds.row >= rect.x1 || bounds.col < rect.y0 || bounds.col >= rect.y1) return;
+		if (leafBlocked(bounds)) {
+			int64_t i = ((int64_t)(bounds.row - rect.x0)) * (rect.y1 - rect.y0) + (bounds.col - rect.y0);
+			local[i >> 6] |= ((uint64_t)1) << (i & 63);
+		}
+		return;
+	}
+	Bounds quadrants[4];
+	int count = splitBounds(bounds, proc->change, quadrants);
+	for (int q = 0; q < count; q++) {
+		fillRect(proc, quadrants[q], rect, local);
+	}
+}
+
+static Rect clipRect(Map& map, Rect rect) {
+	rect.x0 = max(rect.x0, 0);
+	rect.y0 = max(rect.y0, 0);
+	rect.x1 = min(rect.x1, map.rows);
+	rect.y1 = min(rect.y1, map.cols);
+	return rect;
+}
+
+//clears the bits of the tile starting at first for the cells of rect that are free
+static void fillTileRect(Map& map, Rect rect, NodeId first, uint64_t* bits) {
+	rect = clipRect(map, rect);
+	if (rect.x0 >= rect.x1 || rect.y0 >= rect.y1) return;
+	int width = rect.y1 - rect.y0;
+	int64_t area = ((int64_t)(rect.x1 - rect.x0)) * width;
+	vector<uint64_t> local((area + 63) / 64, 0);
+	fillRect(map.procedural, map.procedural->root, rect, local.data());
+	for (int x = rect.x0; x < rect.x1; x++) {
+		for (int y = rect.y0; y < rect.y1; y++) {
+			int64_t i = ((int64_t)(x - rect.x0)) * width + (y - rect.y0);
+			if ((local[i >> 6] >> (i & 63)) & 1) continue;
+			NodeId offset = indexOf(map, x, y) - first;
+			bits[offset >> 6] &= ~(((uint64_t)1) << (offset & 63));
+		}
+	}
+}
+
+//the obstacle bits of a tile, laid out as the map's bitset would hold them. Ids that
+// aren't map cells (padding, the ring) are blocked
+static void fillTile(Map& map, NodeId tile, uint64_t* bits) {
+	Procedural* proc = map.procedural;
+	NodeId first = tile << PROCEDURAL_TILE_SHIFT;
+	NodeId last = min(first + PROCEDURAL_TILE_CELLS, map.cells) - 1;
+	memset(bits, 0xFF, PROCEDURAL_TILE_WORDS * sizeof(uint64_t));
+
+	coord a = coordOf(map, first);
+	if (map.layout == LAYOUT_MORTON) {
+		//the low id bits interleave the low 6 bits of x and y
+		Rect square = {a.x, a.y, a.x + 64, a.y + 64};
+		fillTileRect(map, square, first, bits);
+	}
+	else {
+		//a stretch of one or more rows, each computed on its own so a tile that starts near
+		// the end of a long row doesn't compute all of the next one
+		coord b = coordOf(map, last);
+		for (int x = a.x; x <= b.x; x++) {
+			Rect row = {x, x == a.x ? a.y : 0, x + 1, x == b.x ? b.y + 1 : map.cols};
+			fillTileRect(map, row, first, bits);
+		}
+	}
+
+	omp_set_lock(&(proc->overrideLock));
+	for (size_t o = 0; o < proc->overrides.size(); o++) {
+		NodeId offset = proc->overrides[o].first - first;
+		if (offset < 0 || offset >= PROCEDURAL_TILE_CELLS) continue;
+		uint64_t bit = ((uint64_t)1) << (offset & 63);
+		if (proc->overrides[o].second) bits[offset >> 6] |= bit;
+		else bits[offset >> 6] &= ~bit;
+	}
+	omp_unset_lock(&(proc->overrideLock));
+	__atomic_add_fetch(&(proc->tilesFilled), 1, __ATOMIC_RELAXED);
+}
+
+//least recently used tiles of one thread, of whatever procedural maps it reads. Slots are
+// found by tile id, and a slot whose stamp is out of date is refilled in place
+struct TileCache {
+	NodeId tile[PROCEDURAL_CACHE_TILES];
+	uint64_t stamp[PROCEDURAL_CACHE_TILES];
+	int prev[PROCEDURAL_CACHE_TILES];
+	int next[PROCEDURAL_CACHE_TILES];
+	uint64_t bits[PROCEDURAL_CACHE_TILES][PROCEDURAL_TILE_WORDS];
+	unordered_map<NodeId, int> slotOf;
+	int used;
+	int head;  //most recently used
+	int tail;  //least
+	int last;  //slot of the previous read, -1 before the first
+};
+
+//never freed: omp keeps its threads for the life of the process, and so do their caches
+static __thread TileCache* threadCache = NULL;
+
+static void unlink(TileCache* cache, int slot) {
+	if (cache->prev[slot] != -1) cache->next[cache->prev[slot]] = cache->next[slot];
+	else cache->head = cache->next[slot];
+	if (cache->next[slot] != -1) cache->prev[cache->next[slot]] = cache->prev[slot];
+	else cache->tail = cache->prev[slot];
+}
+
+static void pushFront(TileCache* cache, int slot) {
+	cache->prev[slot] = -1;
+	cache->next[slot] = cache->head;
+	if (cache->head != -1) cache->prev[cache->head] = slot;
+	cache->head = slot;
+	if (cache->tail == -1) cache->tail = slot;
+}
+
+static int cachedTile(TileCache* cache, Map& map, NodeId tile, uint64_t stamp) {
+	unordered_map<NodeId, int>::iterator found = cache->slotOf.find(tile);
+	int slot;
+	if (found != cache->slotOf.end()) {
+		slot = found->second;
+		unlink(cache, slot);
+		if (cache->stamp[slot] != stamp) fillTile(map, tile, cache->bits[slot]);
+	}
+	else {
+		if (cache->used < PROCEDURAL_CACHE_TILES) {
+			slot = cache->used++;
+		}
+		else {
+			slot = cache->tail;
+			unlink(cache, slot);
+			cache->slotOf.erase(cache->tile[slot]);
+		}
+		fillTile(map, tile, cache->bits[slot]);
+		cache->slotOf[tile] = slot;
+	}
+	cache->tile[slot] = tile;
+	cache->stamp[slot] = stamp;
+	pushFront(cache, slot);
+	return slot;
+}
+
+bool proceduralBlocked(Map& map, NodeId node) {
+	TileCache* cache = threadCache;
+	if (cache == NULL) {
+		cache = new TileCache();
+		cache->used = 0;
+		cache->head = -1;
+		cache->tail = -1;
+		cache->last = -1;
+		threadCache = cache;
+	}
+	NodeId tile = node >> PROCEDURAL_TILE_SHIFT;
+	uint64_t stamp = __atomic_load_n(&(map.procedural->stamp), __ATOMIC_RELAXED);
+	int slot = cache->last;
+	//neighbors are mostly in the same tile, so the previous read usually answers this one
+	if (slot == -1 || cache->tile[slot] != tile || cache->stamp[slot] != stamp) {
+		slot = cachedTile(cache, map, tile, stamp);
+		cache->last = slot;
+	}
+	NodeId offset = node & (PROCEDURAL_TILE_CELLS - 1);
+	return (cache->bits[slot][offset >> 6] >> (offset & 63)) & 1;
+}
+
+void overrideBlocked(Map& map, NodeId node, int blocked) {
+	Procedural* proc = map.procedural;
+	omp_set_lock(&(proc->overrideLock));
+	size_t o = 0;
+	while (o < proc->overrides.size() && proc->overrides[o].first != node) o++;
+	if (o == proc->overrides.size()) proc->overrides.push_back(make_pair(node, blocked));
+	else proc->overrides[o].second = blocked;
+	__atomic_store_n(&(proc->stamp), newStamp(), __ATOMIC_RELAXED);
+	omp_unset_lock(&(proc->overrideLock));
+}
+
+//blocked cells of a row-major bitmap between bits from and to
+static int64_t countBits(uint64_t* local, int64_t from, int64_t to) {
+	int64_t count = 0;
+	for (int64_t i = from; i < to; ) {
+		if ((i & 63) == 0 && i + 64 <= to) {
+			count += __builtin_popcountll(local[i >> 6]);
+			i += 64;
+		}
+		else {
+			count += (local[i >> 6] >> (i & 63)) & 1;
+			i++;
+		}
+	}
+	return count;
+}
+
+MetaMap* buildProceduralMap(MapParams params, int seed, int maxHighLevelSideLen) {
+	Map* real = allocateMapUnfilled(params.sidelength, params.change, params.layout, params.stateMode);
+	Procedural* proc = new Procedural();
+	Bounds* bounds = initializeBounds(params);
+	proc->root = *bounds;
+	proc->root.key = mixKey(seed, 0);
+	free(bounds);
+	proc->change = params.change;
+	omp_init_lock(&(proc->overrideLock));
+	proc->stamp = newStamp();
+	proc->tilesFilled = 0;
+	real->procedural = proc;
+
+	//the counts highLevelMap would take from a filled map, and the total for the cutoff
+	if (maxHighLevelSideLen > params.sidelength) maxHighLevelSideLen = params.sidelength;
+	int hlSide = maxHighLevelSideLen;
+	int step = real->cols / hlSide;
+	vector<int64_t> squareBlocked(((int64_t)hlSide) * hlSide, 0);
+	int64_t total = 0;
+	#pragma omp parallel for schedule(dynamic) reduction(+:total)
+	for (int x0 = 0; x0 < real->rows; x0 += STRIP_ROWS) {
+		Rect strip = {x0, 0, min(x0 + STRIP_ROWS, real->rows), real->cols};
+		int64_t area = ((int64_t)(strip.x1 - strip.x0)) * real->cols;
+		vector<uint64_t> local((area + 63) / 64, 0);
+		fillRect(proc, proc->root, strip, local.data());
+		for (int x = strip.x0; x < strip.x1; x++) {
+			int64_t rowStart = ((int64_t)(x - strip.x0)) * real->cols;
+			total += countBits(local.data(), rowStart, rowStart + real->cols);
+			if (x >= hlSide * step) continue;
+			for (int j = 0; j < hlSide; j++) {
+				int64_t count = countBits(local.data(), rowStart + j * step, rowStart + (j + 1) * step);
+				__atomic_add_fetch(&(squareBlocked[(x / step) * hlSide + j]), count, __ATOMIC_RELAXED);
+			}
+		}
+	}
+	proc->blockedCells = total;
+
+	double cutoff = highLevelCutoff(*real);
+	Map* hl = allocateMapLayout(hlSide, 0.0, NULL, params.layout, STATE_DENSE);
+	for (int i = 0; i < hlSide; i++) {
+		for (int j = 0; j < hlSide; j++) {
+			double fraction = ((double)squareBlocked[i * hlSide + j]) / (step * step);
+			setBlocked(*hl, getNode(*hl, i, j), fraction > cutoff ? 1 : 0);
+		}
+	}
+	return assembleMetaMap(real, hl);
+}
+
+void freeProcedural(Procedural* proc) {
+	omp_destroy_lock(&(proc->overrideLock));
+	delete proc;
+}
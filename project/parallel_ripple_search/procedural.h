@@ -0,0 +1,46 @@
+#include <stdint.h>
+
+#include "nodemap.h"
+
+#ifndef PROCEDURAL_H
+#define PROCEDURAL_H
+
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//obstacles computed on demand instead of stored. Every draw obsFiller makes depends only
+// on the key of the quadtree square making it (see mixKey), so whether a cell is blocked
+// can be worked out from the seed by descending through the squares covering it, and
+// comes out exactly as if the map had been filled.
+//Cells are computed a tile at a time, a tile being the cells of PROCEDURAL_TILE_CELLS
+// consecutive ids (a 64x64 square of a Morton map), and each thread keeps the last
+// PROCEDURAL_CACHE_TILES tiles it read. Nothing the size of the map is ever allocated,
+// though building the high level map still reads every cell once
+#define PROCEDURAL_TILE_SHIFT 12
+#define PROCEDURAL_TILE_CELLS (((NodeId)1) << PROCEDURAL_TILE_SHIFT)
+#define PROCEDURAL_TILE_WORDS (PROCEDURAL_TILE_CELLS / 64)
+#define PROCEDURAL_CACHE_TILES 1024
+
+struct Procedural {
+	Bounds root;    //the square obsFiller would start from
+	double change;
+	//cells set with setBlocked since, applied over the computed tiles. Meant for the
+	// handful prs unblocks before searching: each one invalidates every cached tile
+	vector<pair<NodeId, int> > overrides;
+	omp_lock_t overrideLock;
+	uint64_t stamp;        //changes with every override, cached tiles carry the one they were made with
+	int64_t blockedCells;  //on the map, before any overrides
+	uint64_t tilesFilled;  //by all threads, cache misses
+};
+
+//a map like buildMap's, whose real map computes its obstacles. The high level map is built
+// from one pass over the real map's cells, a strip at a time, in parallel
+MetaMap* buildProceduralMap(MapParams params, int seed, int maxHighLevelSideLen);
+void freeProcedural(Procedural* proc);
+
+//setBlocked on a procedural map
+void overrideBlocked(Map& map, NodeId node, int blocked);
+
+#endif
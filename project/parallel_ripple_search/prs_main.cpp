@@ -1,5 +1,16 @@
 #include "nodemap.h"
 #include "fringesearch.h"
+#include "coordinator.h"
+#include "mapfile.h"
+#include "ripple.h"
+#include "portal.h"
+#include "components.h"
+#include "landmarks.h"
+#include "procedural.h"
+#include "tiledfile.h"
+#include "numa.h"
+#include "arena.h"
+#include "stats.h"
 #include <stdbool.h>
 
 #include <omp.h>
@@ -7,6 +18,8 @@
 #include <math.h>
 
 #include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
 #include <iostream>
 
 using namespace std;
@@ -24,8 +37,8 @@ int main(int argc, char** argv) {
     int seed = atoi(argv[4]);
     //fifth: The number of threads
     int threads = atoi(argv[5]);
-    if (threads < 3) {
-        cout << "Must assign at least three threads -- the manager, and the two essential cores" << endl << flush;
+    if (threads < 2) {
+        cout << "Must assign at least two threads -- the start and goal cores" << endl << flush;
         return 0;
     }
     int maxThreads = omp_get_max_threads();
@@ -35,27 +48,228 @@ int main(int argc, char** argv) {
     }
     omp_set_num_threads(threads);
 
+    //optional flags follow the positional arguments:
+    //  --claim lock|cas   how fsearch synchronizes ownership of cells (default cas)
+    //  --map file         load the map from file, or build it and save it there if the
+    //                     file doesn't exist yet
+    //  --stats json|csv   report the per thread counters (see stats.h) at the end
+    //  --jps              expand with jump point pruning
+    //  --hl grid|portal   search the pixelated high level map (default), or the portal
+    //                     graph (see portal.h), whose paths always exist on the real map
+    //  --alt k            estimate with k landmarks (see landmarks.h) as well as manhattan
+    //  --layout plain|padded|morton  how the map's cells are laid out (see LAYOUT_* in nodemap.h)
+    //  --state dense|paged  how the search state is held (see STATE_* in nodemap.h). Paged
+    //                     skips the connected components, labelling them takes a word per cell
+    //  --procedural       compute the obstacles on demand (see procedural.h) instead of
+    //                     filling the map. Not with --map, and skips the components too
+    //  --budget MB        keep at most MB of a --map file's obstacles in memory, paging
+    //                     the rest in tiles (see tiledfile.h)
+    //  --pin compact|scatter|cpus  pin thread i to a CPU (see PIN_* in numa.h), cpus being
+    //                     an explicit list like 0-3,8
+    //  --first-touch      allocate each high level square's memory from the thread whose
+    //                     segment starts nearest to it (see firstTouch)
+    //  either of the two reports where the pages of each thread's squares ended up
+    //  --pages small|thp|hugetlb  which pages the map, state and fringes are allocated
+    //                     on (see PAGES_* in arena.h)
+    int claimMode = CLAIM_CAS;
+    char* mapFile = NULL;
+    int statsFormat = -1;
+    int expansion = EXPAND_ALL;
+    bool portals = false;
+    int numLandmarks = 0;
+    int layout = LAYOUT_PLAIN;
+    int stateMode = STATE_DENSE;
+    bool procedural = false;
+    int64_t tileBudget = 0;
+    int pinMode = PIN_NONE;
+    vector<int> pinList;
+    bool touchFirst = false;
+    int pages = PAGES_SMALL;
+    for (int arg = 6; arg < argc; arg++) {
+        if (strcmp(argv[arg], "--claim") == 0 && arg+1 < argc) {
+            arg++;
+            if (strcmp(argv[arg], "lock") == 0) claimMode = CLAIM_LOCK;
+            else if (strcmp(argv[arg], "cas") == 0) claimMode = CLAIM_CAS;
+            else {
+                cout << "--claim takes lock or cas, not " << argv[arg] << endl << flush;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "--map") == 0 && arg+1 < argc) {
+            mapFile = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--stats") == 0 && arg+1 < argc) {
+            arg++;
+            if (strcmp(argv[arg], "json") == 0) statsFormat = STATS_JSON;
+            else if (strcmp(argv[arg], "csv") == 0) statsFormat = STATS_CSV;
+            else {
+                cout << "--stats takes json or csv, not " << argv[arg] << endl << flush;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "--jps") == 0) {
+            expansion = EXPAND_JUMP;
+        }
+        else if (strcmp(argv[arg], "--hl") == 0 && arg+1 < argc) {
+            arg++;
+            if (strcmp(argv[arg], "grid") == 0) portals = false;
+            else if (strcmp(argv[arg], "portal") == 0) portals = true;
+            else {
+                cout << "--hl takes grid or portal, not " << argv[arg] << endl << flush;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "--alt") == 0 && arg+1 < argc) {
+            numLandmarks = atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "--layout") == 0 && arg+1 < argc) {
+            layout = layoutNamed(argv[++arg]);
+            if (layout == -1) {
+                cout << "--layout takes plain, padded or morton, not " << argv[arg] << endl << flush;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "--state") == 0 && arg+1 < argc) {
+            arg++;
+            if (strcmp(argv[arg], "dense") == 0) stateMode = STATE_DENSE;
+            else if (strcmp(argv[arg], "paged") == 0) stateMode = STATE_PAGED;
+            else {
+                cout << "--state takes dense or paged, not " << argv[arg] << endl << flush;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "--procedural") == 0) {
+            procedural = true;
+        }
+        else if (strcmp(argv[arg], "--budget") == 0 && arg+1 < argc) {
+            tileBudget = atoll(argv[++arg]) * 1024 * 1024;
+        }
+        else if (strcmp(argv[arg], "--pin") == 0 && arg+1 < argc) {
+            arg++;
+            if (strcmp(argv[arg], "compact") == 0) pinMode = PIN_COMPACT;
+            else if (strcmp(argv[arg], "scatter") == 0) pinMode = PIN_SCATTER;
+            else {
+                pinMode = PIN_LIST;
+                if (!parseCpuList(argv[arg], pinList) || pinList.empty()) {
+                    cout << "--pin takes compact, scatter or a list of CPUs like 0-3,8, not " << argv[arg] << endl << flush;
+                    return 1;
+                }
+            }
+        }
+        else if (strcmp(argv[arg], "--first-touch") == 0) {
+            touchFirst = true;
+        }
+        else if (strcmp(argv[arg], "--pages") == 0 && arg+1 < argc) {
+            pages = pageModeNamed(argv[++arg]);
+            if (pages == -1) {
+                cout << "--pages takes small, thp or hugetlb, not " << argv[arg] << endl << flush;
+                return 1;
+            }
+        }
+        else {
+            cout << "Unknown option " << argv[arg] << endl << flush;
+            return 0;
+        }
+    }
+
     cout << "args:" << endl <<
         "sideLen " << mapSideLen << endl <<
         "ratio " << obsRatio << endl <<
         "hl side len " << hlSideLen << endl <<
         "seed " << seed << endl <<
-        "threads " << threads << endl << flush;
+        "threads " << threads << endl <<
+        "claim " << (claimMode == CLAIM_LOCK ? "lock" : "cas") << endl <<
+        "expansion " << (expansion == EXPAND_JUMP ? "jps" : "all") << endl <<
+        "hl " << (portals ? "portal" : "grid") << endl <<
+        "landmarks " << numLandmarks << endl <<
+        "layout " << layoutName(layout) << endl <<
+        "state " << (stateMode == STATE_PAGED ? "paged" : "dense") << endl <<
+        "obstacles " << (procedural ? "procedural" : "filled") << endl <<
+        "budget " << tileBudget / (1024 * 1024) << endl <<
+        "pin " << (pinMode == PIN_COMPACT ? "compact" : pinMode == PIN_SCATTER ? "scatter" :
+                   pinMode == PIN_LIST ? "list" : "none") << endl <<
+        "first touch " << (touchFirst ? "yes" : "no") << endl <<
+        "pages " << pageModeName(pages) << endl << flush;
 
     cout << "got args successfully" << endl << flush;
 
+    setPageMode(pages);
+    Topology topology = readTopology();
+    vector<int> cpus = pinPlan(topology, pinMode, pinList, threads);
+    if (!cpus.empty()) {
+        vector<int> errors;
+        if (!pinThreads(cpus, errors)) {
+            for (int t = 0; t < threads; t++) {
+                if (errors[t] != 0) cout << "Couldn't pin thread " << t << " to CPU " << cpus[t] << ": " << strerror(errors[t]) << endl;
+            }
+            cout << flush;
+            return 1;
+        }
+        cout << "Pinned " << threads << " threads over " << topology.nodes << " nodes, to CPUs";
+        for (int t = 0; t < threads; t++) cout << " " << cpus[t];
+        cout << endl << flush;
+    }
+
 	//singly threaded setup:
     double change = obsRatio / log2(1.0 * mapSideLen);
 	MapParams params = {
 		mapSideLen,
 		obsRatio,
-		change     //change
+		change,     //change
+		layout,
+		stateMode,
+		tileBudget
 	};
-	MetaMap* mmap = buildMap(
-	    params,
-	    seed,
-	    hlSideLen
-	);
+    MetaMap* mmap = NULL;
+    bool ownsBitset = true; //not if it's in a map file
+    if (procedural) {
+        mmap = buildProceduralMap(params, seed, hlSideLen);
+    }
+    else if (mapFile != NULL) {
+        int fileSeed;
+        int loaded = loadMapFile(mapFile, &params, &fileSeed, &mmap);
+        if (loaded == MAPFILE_INVALID) {
+            cout << "Not building a map over " << mapFile << ", give --map a map file or a path with nothing there" << endl << flush;
+            return 1;
+        }
+        if (loaded == MAPFILE_LOADED) {
+            cout << "Loaded map from " << mapFile << endl << flush;
+            ownsBitset = false;
+            if (params.sidelength != mapSideLen || params.obsratio != obsRatio ||
+                fileSeed != seed || mmap->meta->cols != hlSideLen || params.layout != layout) {
+                cout << "Warn: " << mapFile << " holds a " << params.sidelength << " map, ratio " <<
+                    params.obsratio << ", hl side len " << mmap->meta->cols << ", seed " << fileSeed <<
+                    ", " << layoutName(params.layout) <<
+                    "; using it instead of the arguments" << endl << flush;
+            }
+            mapSideLen = params.sidelength;
+        }
+    }
+    if (mmap == NULL) {
+        mmap = buildMap(
+            params,
+            seed,
+            hlSideLen
+        );
+        if (mapFile != NULL && saveMapFile(mapFile, mmap, params, seed)) {
+            cout << "Saved map to " << mapFile << endl << flush;
+            //only a mapped file's obstacles can be paged, so with a budget carry on with the
+            // file just written rather than the map built in memory
+            MetaMap* saved = NULL;
+            int fileSeed;
+            if (tileBudget > 0 && loadMapFile(mapFile, &params, &fileSeed, &saved) == MAPFILE_LOADED) {
+                freeMetaMap(mmap);
+                mmap = saved;
+                ownsBitset = false;
+                cout << "Reopened " << mapFile << " to page its obstacles" << endl << flush;
+            }
+        }
+    }
+    if (tileBudget > 0 && mmap->real->tiles == NULL) {
+        cout << "Warn: --budget only pages the obstacles of a --map file, keeping all of them in memory" << endl << flush;
+    }
+    mmap->claimMode = claimMode;
+    mmap->expansion = expansion;
 
     cout << "Constructed map" << endl <<flush;
 
@@ -67,264 +281,188 @@ int main(int argc, char** argv) {
     coord hlGoal = bigToLittle(mmap, goal);
 
     //manually unblock start and goal:
-    getNode(mmap->real, start.x, start.y)->blocked = 0;
-    getNode(mmap->real, goal.x, goal.y)->blocked = 0;
-    getNode(mmap->meta, hlGoal.x, hlGoal.y)->blocked = 0;
-    getNode(mmap->meta, hlStart.x, hlStart.y)->blocked = 0;
-
-    cout << "About to HL Search" << endl << flush;
+    setBlocked(*mmap->real, getNode(mmap->real, start.x, start.y), 0);
+    setBlocked(*mmap->real, getNode(mmap->real, goal.x, goal.y), 0);
+    setBlocked(*mmap->meta, getNode(mmap->meta, hlGoal.x, hlGoal.y), 0);
+    setBlocked(*mmap->meta, getNode(mmap->meta, hlStart.x, hlStart.y), 0);
+
+    //turn down a start and goal that can't reach each other before any search
+    Components* components = stateMode == STATE_PAGED || procedural ? NULL : labelComponents(*mmap->real);
+    if (components != NULL && !connected(components, getNode(mmap->real, start.x, start.y), getNode(mmap->real, goal.x, goal.y))) {
+        cout << "The start and goal are in different components, no path exists. Try a different seed" << endl << flush;
+        return 0;
+    }
 
-    //Run pathfinding on higher level graph
-    list<coord>* hlPath = hlsearch(mmap, start, goal);
+    int cores = threads; //every thread searches, there is no master core
+    coord* coreStartPoints;
 
-    if (hlPath == NULL) {
+    if (portals) {
+        double buildStart = omp_get_wtime();
+        PortalGraph* graph = buildPortalGraph(mmap);
+        cout << "Built portal graph: " << graph->count << " portals, " << graph->edgeStart[graph->count] <<
+            " edges in " << omp_get_wtime() - buildStart << "s" << endl << flush;
 
-        printMap(*mmap->real);
-        cout << "\n" << "\n";
-        printMap(*mmap->meta);
+        cout << "About to HL Search" << endl << flush;
+        vector<int> costs;
+        list<coord>* portalPath = portalSearch(graph, *mmap->real, start, goal, &costs);
+        if (portalPath == NULL) {
+            cout << "The goal can't be reached from the start. Try a different seed" << endl << flush;
+            return 0;
+        }
+        cout << "HL Search Complete, " << portalPath->size() << " portals, cost " << costs.back() << endl << flush;
 
-        cout << "High Level search didn't yield a path. Try a different seed" << endl << flush;
-        return 0;
+        cout << "Assigning Cores" << endl << flush;
+        coreStartPoints = placeSegmentsByCost(portalPath, costs, &cores);
+        if (cores < threads) {
+            cout << "Warn: the portal path has only " << portalPath->size() << " cells, searching with " <<
+                cores << " segments" << endl << flush;
+        }
+        delete portalPath;
+        freePortalGraph(graph);
     }
+    else {
+        cout << "About to HL Search" << endl << flush;
 
-    cout << "HL Search Complete" << endl << flush;
+        //Run pathfinding on higher level graph
+        list<coord>* hlPath = hlsearch(mmap, start, goal);
 
-    list<coord>::iterator it = hlPath->begin();
-    while (it != hlPath->end()) {
-        coord current = *it;
-        //cout << current.x << " " << current.y << endl << flush;
-        it++;
-    }
+        if (hlPath == NULL) {
+
+            printMap(*mmap->real);
+            cout << "\n" << "\n";
+            printMap(*mmap->meta);
 
-    cout << "Assigning Cores" << endl << flush;
+            cout << "High Level search didn't yield a path. Try a different seed" << endl << flush;
+            return 0;
+        }
 
-    int cores = threads-1; //slave cores, 0->(threads-2)
+        cout << "HL Search Complete" << endl << flush;
 
-    coord coreStartPoints[cores];
+        if (mmap->real->tiles != NULL) {
+            cout << "Prefetched " << prefetchPath(mmap, hlPath) << " obstacle tiles along the path" << endl << flush;
+        }
 
-    int step = hlPath->size() / cores; // deliberate rounding down
+        cout << "Assigning Cores" << endl << flush;
 
-    //assign the start points of each core
-    coreStartPoints[cores-1] = littleToBig(mmap, hlPath->back()); //goal core
-    for (int c = 0; c < cores-1; c++) { //start core and all others
-        coreStartPoints[c] = littleToBig(mmap, hlPath->front());
-        for (int s = 0; s < step; s++) {
-            hlPath->pop_front();
+        coreStartPoints = placeSegments(mmap, hlPath, &cores);
+        if (cores < threads) {
+            cout << "Warn: the high level path has only " << hlPath->size() << " squares, searching with " <<
+                cores << " segments" << endl << flush;
         }
+        //a square with no cell in the start's component can't host a segment, drop it rather
+        // than unblock a cell in a pocket. The start's and goal's squares always have one
+        int kept = 0;
+        for (int c = 0; components != NULL && c < cores; c++) {
+            if (connectedCellIn(mmap, components, coreStartPoints[c], start, &coreStartPoints[kept])) kept++;
+            else cout << "Warn: no connected start in the square of core " << c << ", dropping it" << endl << flush;
+        }
+        if (components != NULL) cores = kept;
     }
+    if (components != NULL) freeComponents(components);
 
     for (int c = 0; c < cores; c++) {
         coord crd = coreStartPoints[c];
-        getNode(mmap->real, crd.x, crd.y)->blocked = 0; //manually ensure no core is assigned to a blocked grid
+        setBlocked(*mmap->real, getNode(mmap->real, crd.x, crd.y), 0); //manually ensure no core is assigned to a blocked grid
         cout << "core " << c << " assigned " << crd.x << " " << crd.y << endl;
     }
 
-    fs** searchInstances = new fs*[cores];
-
-    cout << "Initializing fs instances" << endl << flush;
-    for (int c = 0; c < cores; c++) {
-        coord* goals;
-        int numGoals;
-        if (c==0) {
-            goals = new coord[1];
-            numGoals = 1;
-            goals[0] = coreStartPoints[c+1];
-        }
-        else if (c==cores-1) {
-            numGoals = 1;
-            goals = new coord[1];
-            goals[0] = coreStartPoints[c-1];
-        }
-        else {
-            numGoals = 2;
-            goals = new coord[2];
-            goals[0] = coreStartPoints[c-1];
-            goals[1] = coreStartPoints[c+1];
-        }
-
-        searchInstances[c] = buildFS(
-            mmap,
-            1,
-            coreStartPoints[c],
-            goals,
-            numGoals
-        );
+    //before anything writes a state word
+    vector<int> owners;
+    if (touchFirst || pinMode != PIN_NONE) owners = squareOwners(mmap, coreStartPoints, cores);
+    if (touchFirst) {
+        double touchStart = omp_get_wtime();
+        firstTouch(mmap, owners, cores, ownsBitset);
+        cout << "First touched the map in " << omp_get_wtime() - touchStart << "s" << endl << flush;
     }
 
-    int* masterHalt = new int[cores]; //for master to tell slaves to stop
-    int* slaveAck = new int[cores];  //for slaves to signal that they've stopped
-    int* totallyDone = new int[cores]; //indicates that a slave has found all neighbors
-    int* outOfNodes = new int[cores];
-
-    int master = threads-1; //master core
-    for (int i = 0; i < cores; i++) {
-        masterHalt[i] = 0;
-        slaveAck[i] = 0;
-        totallyDone[i] = 0;
-        outOfNodes[i] = 0;
+    //after the cores are unblocked, the distances have to be those of the map searched
+    if (numLandmarks > 0) {
+        double buildStart = omp_get_wtime();
+        mmap->landmarks = buildLandmarks(*mmap->real, numLandmarks);
+        cout << "Built " << numLandmarks << " landmarks in " << omp_get_wtime() - buildStart << "s" << endl << flush;
     }
 
-    double startTime = omp_get_wtime();
-    #pragma omp parallel // this is where the magic happens
-    {
-        int id = omp_get_thread_num();
-
-        if (id == master) { //master coordinates other cores
-            int totallyDoneCount = 0;
-            while (totallyDoneCount < cores) {
-                //wait for rendevous
-                /*
-                int rendevous = 0;
-                while (!rendevous) {
-                    int count = 0;
-                    for (int c = 0; c < cores; c++) {
-                        int ack, tdone;
-                        #pragma omp atomic read
-                        ack = slaveAck[c];
-                        #pragma omp atomic read
-                        tdone = totallyDone[c];
-
-                        if (tdone || ack) count++;
-                    }
-                    rendevous = (count == cores);
-                    if (rendevous) cout << rendevous << endl;
-                    cout << "Count: " << count << " Cores " << cores << endl;
-                }
-                */
-                //act on each core
-                for (int c = 0; c < cores; c++) {
-                    int done;
-                    #pragma omp atomic read
-                    done = totallyDone[c];
-                    if (done) continue;
-
-                    int ack;
-                    #pragma omp atomic read
-                    ack = slaveAck[c];
-                    if (ack) { //slave is waiting to be checked up on
-                        fs* cInst = searchInstances[c];
-                        int badStatus;
-                        #pragma omp atomic read
-                        badStatus = outOfNodes[c];
-                        if (cInst->goalsFound == cInst->numGoals) {
-                            cout << "Master: slave " << c << " successfully finished" << endl << flush;
-                            //mark slave as finished
-                            totallyDoneCount++;
-                            #pragma omp atomic write
-                            totallyDone[c] = 1;
-                        }
-                        else if (badStatus) {
-                            cout << "Master: slave " << c << " FAILED" << endl << flush;
-                            totallyDoneCount++;
-                            #pragma omp atomic write
-                            totallyDone[c] = 1;
-                        }
-                        #pragma omp atomic write
-                        masterHalt[c] = 0;
-                        #pragma omp atomic write
-                        slaveAck[c] = 0;
-                    }
-                }
-            }
-        }
-        else {
-            //cout << "I am slave " << id << endl;
-            fs* mySearch = searchInstances[id];
-            int done = 0;
-            while (!done) {
-                //check for master interrupts
-                int haltByMaster;
-                #pragma omp atomic read
-                haltByMaster = masterHalt[id];
-                if (haltByMaster) {
-                    #pragma omp atomic write
-                    slaveAck[id] = 1; //signal that you're waiting
-                    continue;
-                }
-
-                //check if waiting on master to be attended to
-                int waitingOnMaster;
-                #pragma omp atomic read
-                waitingOnMaster = slaveAck[id];
-                if (waitingOnMaster) {
-                    continue;
-                }
+    cout << "Initializing fs instances" << endl << flush;
+    fs** searchInstances = buildSegments(mmap, coreStartPoints, cores);
 
-                //cout << "core " << id << " searching" << endl;
-                int retStatus = fsearch(mySearch, 2000);
-                #pragma omp atomic write
-                outOfNodes[id] = retStatus;
-                #pragma omp atomic write
-                slaveAck[id] = 1;
+    Coordinator* coordinator = buildCoordinator(searchInstances, cores);
 
-                //check for validation from master that the core is done
-                #pragma omp atomic read
-                done = totallyDone[id];
-            }
+    resetStats();
+    struct rusage usageBefore;
+    getrusage(RUSAGE_SELF, &usageBefore);
+    double startTime = omp_get_wtime();
+    if (!searchSegments(coordinator)) {
+        cout << "omp ran fewer than " << cores << " threads, one per segment is needed" << endl << flush;
+        freeCoordinator(coordinator);
+        return 1;
+    }
 
-        }
+    for (int c = 0; c < cores; c++) {
+        int state = statusOf(coordinator, c);
+        if (state == SLAVE_FINISHED) cout << "Segment " << c << " successfully finished" << endl << flush;
+        else if (state == SLAVE_FAILED) cout << "Segment " << c << " FAILED" << endl << flush;
+        else cout << "Segment " << c << " stopped" << endl << flush;
     }
 
     double totalTime = omp_get_wtime() - startTime;
 
     cout << "End Parallel Section" << endl << flush;
 
-    cout << "Constructing Master Path" << endl << flush;
-    list<coord> * masterList = new list<coord>();
-
-    cout << "Iterating from start node" << endl << flush;
-    list<Node*>::iterator nit = searchInstances[0]->paths[0]->begin();
-    while (nit != searchInstances[0]->paths[0]->end()) {
-        masterList->push_back((*nit)->coordinate);
-        nit++;
+    if (stateMode == STATE_PAGED) {
+        Map& real = *mmap->real;
+        cout << "Search state: " << real.numPagesUsed << " of " << statePageCount(real) << " pages, " <<
+            real.numPagesUsed * STATE_PAGE_CELLS * (sizeof(NodeState) + sizeof(int)) / (1024 * 1024) << " MB" << endl << flush;
     }
-
-    for (int i = 1; i < cores-1; i++) {
-        cout << "Intermediary Node " << i << endl << flush;
-        //get all coordinates leading to i
-        Node* bridge = getNode(*mmap->real, masterList->back().x, masterList->back().y);
-        list<Node*> * toI = getPath(bridge);
-        toI->pop_back();
-        while (!toI->empty()) {
-            masterList->push_back(toI->back()->coordinate);
-            toI->pop_back();
+    if (pages != PAGES_SMALL) {
+        cout << "Huge pages: " << (arenaBytes(PAGES_HUGETLB) >> 20) << " MB hugetlb, " <<
+            (arenaBytes(PAGES_THP) >> 20) << " MB madvised, of which " << (transparentHugeBytes() >> 20) <<
+            " MB backed by transparent huge pages" << endl << flush;
+    }
+    if (!owners.empty()) {
+        if (cpus.empty()) cpus = currentCpus(threads);
+        placementReport(stdout, mmap, owners, cpus, topology);
+    }
+    if (procedural) {
+        cout << "Obstacle tiles computed: " << mmap->real->procedural->tilesFilled << endl << flush;
+    }
+    if (mmap->real->tiles != NULL) {
+        TiledFile* tiles = mmap->real->tiles;
+        uint64_t hits = 0, misses = 0, dropped = 0;
+        for (int t = 0; t < threads; t++) {
+            hits += statsTable[t].tileHits;
+            misses += statsTable[t].tileMisses;
+            dropped += statsTable[t].tilesDropped;
         }
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        cout << "Obstacle tiles: " << tiles->residentTiles << " of " << tiles->tiles << " resident, hits " << hits <<
+            ", misses " << misses << ", dropped " << dropped << "; page faults " <<
+            usage.ru_minflt - usageBefore.ru_minflt << " minor, " << usage.ru_majflt - usageBefore.ru_majflt <<
+            " major" << endl << flush;
+    }
 
-        //get all coordinates owned by i which lead to i+1
-        list<Node*> * toNext = searchInstances[i]->paths[1];
-        nit = toNext->begin();
-        while (nit != toNext->end()) {
-            masterList->push_back((*nit)->coordinate);
-            nit++;
-        }
+    if (statsFormat != -1) {
+        writeStats(stdout, threads, statsFormat);
     }
 
-    cout << "Goal Node" << endl << flush;
-    Node* bridge = getNode(*mmap->real, masterList->back().x, masterList->back().y);
-    list<Node*> * toGoal = getPath(bridge);
-    toGoal->pop_back();
-    while (toGoal->size() > 0) {
-        coord c = toGoal->back()->coordinate;
-        masterList->push_back(c);
-        toGoal->pop_back();
+    bool failed = coordinator->failed;
+    freeCoordinator(coordinator);
+    if (failed) {
+        cout << "A segment ran out of nodes, no master path exists" << endl << flush;
+        return 0;
     }
 
+    cout << "Constructing Master Path" << endl << flush;
+    list<coord> * masterList = stitchPath(mmap, searchInstances, cores);
+
     cout << "Master path produced:" << endl;
 
-    list<coord>::iterator mit = masterList->begin();
-    coord prev = masterList->front();
-    while (mit != masterList->end()) {
-        coord c = *mit;
-        if (manhattan(prev, c) > 1) {
-            cout << "Master Path Integrity Check Fail" << endl;
-            return 0;
-        }
-        prev = c;
-        //cout << c.x << " " << c.y << endl;
-        mit++;
+    if (!pathIntact(masterList)) {
+        cout << "Master Path Integrity Check Fail" << endl;
+        return 0;
     }
 
-    cout << "Cores: " << threads << endl;
+    cout << "Cores: " << cores << endl;
     cout << "Time: " << totalTime << endl;
 
 }
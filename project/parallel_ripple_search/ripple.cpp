@@ -0,0 +1,175 @@
+#include "ripple.h"
+
+//spreads the segment start points evenly along hlPath, first at the path's start and last
+// at its end. Points are real map coordinates (the corner of their high level square).
+//Every segment gets a square of its own, so if the path has fewer squares than segments
+// asks for, segments is lowered to that (but never below the two ends)
+coord* placeSegments(MetaMap* mmap, list<coord>* hlPath, int* segmentsPlaced) {
+	int segments = min(*segmentsPlaced, max(2, (int)hlPath->size()));
+	*segmentsPlaced = segments;
+	coord* points = new coord[segments];
+
+	int step = hlPath->size() / segments; // deliberate rounding down
+
+	//assign the start points of each core
+	points[segments-1] = littleToBig(mmap, hlPath->back()); //goal core
+	list<coord>::iterator it = hlPath->begin();
+	for (int c = 0; c < segments-1; c++) { //start core and all others
+		points[c] = littleToBig(mmap, *it);
+		for (int s = 0; s < step; s++) {
+			it++;
+		}
+	}
+	return points;
+}
+
+//spreads the segment start points along a path of real cells by cost, such as the portals
+// from portalSearch: segment c starts on the cell whose cost is nearest c/(segments-1) of
+// the whole. The cells are open already. Like placeSegments, every segment gets a cell of
+// its own, so segments is lowered to the path's length if it is shorter
+coord* placeSegmentsByCost(list<coord>* path, vector<int>& costs, int* segmentsPlaced) {
+	int segments = min(*segmentsPlaced, max(2, (int)path->size()));
+	*segmentsPlaced = segments;
+	coord* points = new coord[segments];
+	vector<coord> cells(path->begin(), path->end());
+	int last = cells.size() - 1;
+	long long total = costs[last];
+
+	points[0] = cells[0];
+	points[segments-1] = cells[last];
+	int prev = 0;
+	for (int c = 1; c < segments-1; c++) {
+		long long target = total * c / (segments-1);
+		int i = prev;
+		while (i < last && costs[i] < target) i++;
+		if (i > 0 && target - costs[i-1] < costs[i] - target) i--;
+		i = min(max(i, prev + 1), last - (segments-1 - c));
+		points[c] = cells[i];
+		prev = i;
+	}
+	return points;
+}
+
+//segment starts must be open cells. The high level squares on the path are mostly open,
+// so take the first open cell of the square if its corner is blocked. x indexes rows and
+// y columns, as in getNode
+coord openCellIn(MetaMap* mmap, coord corner) {
+	Map& real = *mmap->real;
+	for (int x = corner.x; x < corner.x + mmap->factor && x < real.rows; x++) {
+		for (int y = corner.y; y < corner.y + mmap->factor && y < real.cols; y++) {
+			if (!isBlocked(real, x, y)) {
+				coord open = {x, y};
+				return open;
+			}
+		}
+	}
+	return corner;
+}
+
+//like openCellIn, but the cell also has to be in the same component as to, so the
+// segment doesn't start in a pocket it can't leave. Returns false if no cell of the
+// square is, leaving cell alone
+bool connectedCellIn(MetaMap* mmap, Components* comps, coord corner, coord to, coord* cell) {
+	Map& real = *mmap->real;
+	NodeId target = getNode(real, to.x, to.y);
+	for (int x = corner.x; x < corner.x + mmap->factor && x < real.rows; x++) {
+		for (int y = corner.y; y < corner.y + mmap->factor && y < real.cols; y++) {
+			if (connected(comps, getNode(real, x, y), target)) {
+				cell->x = x;
+				cell->y = y;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+//each segment searches towards its neighbors' start points
+fs** buildSegments(MetaMap* mmap, coord* points, int segments) {
+	fs** instances = new fs*[segments];
+	for (int c = 0; c < segments; c++) {
+		coord* goals;
+		int numGoals;
+		if (c==0) {
+			goals = new coord[1];
+			numGoals = 1;
+			goals[0] = points[c+1];
+		}
+		else if (c==segments-1) {
+			numGoals = 1;
+			goals = new coord[1];
+			goals[0] = points[c-1];
+		}
+		else {
+			numGoals = 2;
+			goals = new coord[2];
+			goals[0] = points[c-1];
+			goals[1] = points[c+1];
+		}
+
+		instances[c] = buildFS(
+			mmap,
+			1,
+			points[c],
+			goals,
+			numGoals
+		);
+	}
+	return instances;
+}
+
+//appends the cells leading from bridge back to the start of the instance owning it
+static void appendBackToOrigin(Map& real, list<coord>* path, NodeId bridge) {
+	list<NodeId> * toOrigin = getPath(real, bridge);
+	toOrigin->pop_back();
+	while (!toOrigin->empty()) {
+		path->push_back(coordOf(real, toOrigin->back()));
+		toOrigin->pop_back();
+	}
+	delete toOrigin;
+}
+
+//joins the paths of finished segments into one path from the first segment's start to
+// the last one's. Each segment's path ends on a cell owned by the next segment, whose
+// parents lead back to that segment's start
+list<coord>* stitchPath(MetaMap* mmap, fs** segments, int count) {
+	Map& real = *mmap->real;
+	list<coord> * masterList = new list<coord>();
+
+	list<NodeId>::iterator nit = segments[0]->paths[0]->begin();
+	while (nit != segments[0]->paths[0]->end()) {
+		masterList->push_back(coordOf(real, *nit));
+		nit++;
+	}
+
+	for (int i = 1; i < count-1; i++) {
+		//get all coordinates leading to i
+		appendBackToOrigin(real, masterList, getNode(real, masterList->back().x, masterList->back().y));
+
+		//get all coordinates owned by i which lead to i+1
+		list<NodeId> * toNext = segments[i]->paths[1];
+		nit = toNext->begin();
+		while (nit != toNext->end()) {
+			masterList->push_back(coordOf(real, *nit));
+			nit++;
+		}
+	}
+
+	appendBackToOrigin(real, masterList, getNode(real, masterList->back().x, masterList->back().y));
+	return masterList;
+}
+
+//true if every step of path moves to a neighboring cell
+bool pathIntact(list<coord>* path) {
+	list<coord>::iterator mit = path->begin();
+	coord prev = path->front();
+	while (mit != path->end()) {
+		coord c = *mit;
+		if (manhattan(prev, c) > 1) {
+			return false;
+		}
+		prev = c;
+		mit++;
+	}
+	return true;
+}
@@ -0,0 +1,22 @@
+#include "nodemap.h"
+#include "fringesearch.h"
+#include "components.h"
+
+#include <vector>
+
+#ifndef RIPPLE_H
+#define RIPPLE_H
+
+//the pieces of a ripple search that don't depend on how its segments get scheduled:
+// placing segment starts along the high level path, building their instances and
+// stitching their paths into one
+
+coord* placeSegments(MetaMap* mmap, list<coord>* hlPath, int* segments);
+coord* placeSegmentsByCost(list<coord>* path, vector<int>& costs, int* segments);
+coord openCellIn(MetaMap* mmap, coord corner);
+bool connectedCellIn(MetaMap* mmap, Components* comps, coord corner, coord to, coord* cell);
+fs** buildSegments(MetaMap* mmap, coord* points, int segments);
+list<coord>* stitchPath(MetaMap* mmap, fs** segments, int count);
+bool pathIntact(list<coord>* path);
+
+#endif
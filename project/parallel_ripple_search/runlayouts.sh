@@ -0,0 +1,9 @@
+#!/bin/bash
+#row-major vs Morton order (see LAYOUT_* in nodemap.h) on the runprs.sh map. bench's fsearch
+# row is a single search instance, its work_per_s is expansions/s; prs is the whole ripple search
+export OMP_NUM_THREADS=10
+./bench --sizes 16000 --ratios .2 --hl 32 --seeds 3 --layouts plain,morton --warmup 0 --reps 3
+for LAYOUT in plain morton
+do
+    ./prs 16000 .2 32 3 10 --layout $LAYOUT --stats csv
+done
@@ -0,0 +1,10 @@
+#!/bin/bash
+#small vs huge pages (see PAGES_* in arena.h) on the runprs.sh map. bench's dtlb_misses column
+# needs perf to reach the TLB counters (perf_event_paranoid <= 2, a PMU the kernel exposes),
+# and hugetlb a reserved pool, e.g. echo 2560 > /proc/sys/vm/nr_hugepages
+export OMP_NUM_THREADS=10
+./bench --sizes 16000 --ratios .2 --hl 32 --seeds 3 --pages small,thp,hugetlb --warmup 1 --reps 3
+for PAGES in small thp hugetlb
+do
+    ./prs 16000 .2 32 3 10 --pages $PAGES --stats csv
+done
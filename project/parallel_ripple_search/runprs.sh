@@ -1,3 +1,7 @@
 #!/bin/bash
 ./prs 16000               .2               32                 3      10
 #     side len of map :  obstacle ratio : hl side length : seed : num threads
+#     optional: --claim lock|cas  (A/B the cell ownership synchronization)
+#     optional: --stats json|csv  (per thread counters, see stats.h)
+#     optional: --layout plain|padded|morton  (how the cells are laid out, see runlayouts.sh)
+#     optional: --pages small|thp|hugetlb  (huge page backed arrays, see runpages.sh)
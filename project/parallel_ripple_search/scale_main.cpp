@@ -0,0 +1,299 @@
+#include "nodemap.h"
+#include "fringesearch.h"
+#include "coordinator.h"
+#include "ripple.h"
+#include "astar.h"
+#include "stats.h"
+
+#include <omp.h>
+
+#include <math.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+//measures whether prs beats a good serial search. For every map and seed the baselines
+// run first: a binary heap A* (whose path is the optimum) and the single instance fsearch
+// of fs_main. Then the ripple search runs with min..max threads, from the high level
+// search to the stitched path, so it's timed on the same terms as the baselines.
+//  strong: the map stays the same as threads are added
+//  weak:   the map's area grows with the thread count, side*sqrt(threads/min)
+//Results are CSV, one row per solver and thread count. Speedup is against A* on the
+// same map; efficiency is speedup/threads for strong scaling, and the min thread time
+// over this time for weak scaling
+
+#define MODE_STRONG 0
+#define MODE_WEAK   1
+
+struct ScaleConfig {
+    int mode;
+    int side;
+    double ratio;
+    int hlSide;
+    vector<int> seeds;
+    int minThreads;
+    int maxThreads;
+    int reps;
+};
+
+static double median(vector<double>& times) {
+    sort(times.begin(), times.end());
+    int n = times.size();
+    return n % 2 ? times[n/2] : (times[n/2 - 1] + times[n/2]) / 2;
+}
+
+//the moves in a path of cells, -1 if there's no path
+static int lengthOf(int cells) {
+    return cells > 0 ? cells - 1 : -1;
+}
+
+static double timeAstar(MetaMap* mmap, coord start, coord goal, int* length, long* expansions) {
+    double begin = omp_get_wtime();
+    list<NodeId>* path = astar(*mmap->real, start, goal, expansions);
+    double taken = omp_get_wtime() - begin;
+    *length = lengthOf(path != NULL ? path->size() : 0);
+    delete path;
+    return taken;
+}
+
+static double timeFsearch(MetaMap* mmap, coord start, coord goal, int* length, long* expansions) {
+    coord goals[] = {goal};
+    coord otherGoals[] = {start};
+    newSearch(*mmap->real);
+    resetStats();
+    double begin = omp_get_wtime();
+    fs* search = buildFS(mmap, 1, start, goals, 1);
+    //the goal is only recognized once another instance owns it
+    fs* other = buildFS(mmap, 1, goal, otherGoals, 1);
+    while (search->goalsFound < 1) {
+        if (fsearch(search, 2000) == -1) break;
+    }
+    double taken = omp_get_wtime() - begin;
+    //the path ends on the goal instance's origin
+    *length = lengthOf(search->paths[0] != NULL ? search->paths[0]->size() : 0);
+    *expansions = threadStats()->expanded;
+    delete search->paths[0];
+    freeFS(search);
+    freeFS(other);
+    return taken;
+}
+
+//one whole ripple search with the given number of threads. placed is how many segments
+// the high level path had room for; if that's fewer than threads nothing is searched
+static double timeRipple(MetaMap* mmap, coord start, coord goal, int threads, int* length, int* placed) {
+    *length = -1;
+    *placed = threads;
+    newSearch(*mmap->real);
+    double begin = omp_get_wtime();
+    list<coord>* hlPath = hlsearch(mmap, start, goal);
+    if (hlPath == NULL) return omp_get_wtime() - begin;
+
+    coord* points = placeSegments(mmap, hlPath, placed);
+    if (*placed < threads) {
+        delete hlPath;
+        delete[] points;
+        return 0;
+    }
+    points[0] = start;
+    points[threads-1] = goal;
+    for (int c = 1; c < threads-1; c++) {
+        points[c] = openCellIn(mmap, points[c]);
+    }
+    delete hlPath;
+
+    fs** segments = buildSegments(mmap, points, threads);
+    Coordinator* coordinator = buildCoordinator(segments, threads);
+    if (searchSegments(coordinator) && !coordinator->failed) {
+        list<coord>* path = stitchPath(mmap, segments, threads);
+        if (pathIntact(path)) *length = lengthOf(path->size());
+        delete path;
+    }
+    double taken = omp_get_wtime() - begin;
+
+    freeCoordinator(coordinator);
+    for (int c = 0; c < threads; c++) {
+        delete[] segments[c]->goals;
+        for (int g = 0; g < segments[c]->numGoals; g++) {
+            delete segments[c]->paths[g];
+        }
+        freeFS(segments[c]);
+    }
+    delete[] segments;
+    delete[] points;
+    return taken;
+}
+
+static MetaMap* cornerMap(int side, double ratio, int hlSide, int seed, coord* start, coord* goal) {
+    MapParams params = {
+        side,
+        ratio,
+        ratio / log2(1.0 * side)
+    };
+    MetaMap* mmap = buildMap(params, seed, hlSide);
+
+    //same corners as prs
+    start->x = 1;
+    start->y = 1;
+    goal->x = side - 2;
+    goal->y = side - 2;
+    coord hlStart = bigToLittle(mmap, *start);
+    coord hlGoal = bigToLittle(mmap, *goal);
+    setBlocked(*mmap->real, getNode(mmap->real, start->x, start->y), 0);
+    setBlocked(*mmap->real, getNode(mmap->real, goal->x, goal->y), 0);
+    setBlocked(*mmap->meta, getNode(mmap->meta, hlStart.x, hlStart.y), 0);
+    setBlocked(*mmap->meta, getNode(mmap->meta, hlGoal.x, hlGoal.y), 0);
+    return mmap;
+}
+
+static void writeRow(FILE* out, ScaleConfig& config, int side, int seed, int threads, const char* solver,
+                     double time, double astarTime, double efficiency, int length, int optimum, long expansions) {
+    //a failed search has no speedup to speak of
+    double subopt = (length >= 0 && optimum > 0) ? ((double)length) / optimum : 0;
+    if (length < 0) {
+        astarTime = 0;
+        efficiency = 0;
+    }
+    fprintf(out, "%s,%d,%g,%d,%d,%d,%s,%.6f,%.3f,%.3f,%d,%d,%.4f,%ld\n",
+        config.mode == MODE_STRONG ? "strong" : "weak", side, config.ratio, config.hlSide, seed,
+        threads, solver, time, time > 0 ? astarTime / time : 0, efficiency, length, optimum, subopt, expansions);
+    fflush(out);
+}
+
+//the A* baseline of a map, which every ripple search on it is compared to
+struct Baseline {
+    double astarTime;
+    int optimum;
+};
+
+//builds the map and runs the baselines on it. Returns NULL if there's no path
+static MetaMap* prepareMap(FILE* out, ScaleConfig& config, int side, int seed, coord* start, coord* goal, Baseline* base) {
+    MetaMap* mmap = cornerMap(side, config.ratio, config.hlSide, seed, start, goal);
+
+    vector<double> times;
+    long expansions = 0;
+    for (int r = 0; r < config.reps; r++) times.push_back(timeAstar(mmap, *start, *goal, &base->optimum, &expansions));
+    base->astarTime = median(times);
+    if (base->optimum < 0) {
+        cerr << "No path on side " << side << " seed " << seed << ", try a different seed" << endl;
+        freeMetaMap(mmap);
+        return NULL;
+    }
+    writeRow(out, config, side, seed, 1, "astar", base->astarTime, base->astarTime, 1, base->optimum, base->optimum, expansions);
+
+    int length = -1;
+    times.clear();
+    for (int r = 0; r < config.reps; r++) times.push_back(timeFsearch(mmap, *start, *goal, &length, &expansions));
+    double fsTime = median(times);
+    writeRow(out, config, side, seed, 1, "fsearch", fsTime, base->astarTime, base->astarTime / fsTime, length, base->optimum, expansions);
+    return mmap;
+}
+
+//runs the ripple search on a prepared map, returning its time, or 0 if the high level path
+// is too short to give every thread a segment of its own
+static double runRipple(FILE* out, ScaleConfig& config, MetaMap* mmap, int side, int seed, coord start, coord goal,
+                        Baseline& base, int threads, double weakBase) {
+    int length = -1;
+    int placed = threads;
+    vector<double> times;
+    for (int r = 0; r < config.reps && placed == threads; r++) {
+        times.push_back(timeRipple(mmap, start, goal, threads, &length, &placed));
+    }
+    if (placed < threads) {
+        cerr << "The high level path on side " << side << " seed " << seed << " has room for only " << placed <<
+            " segments, skipping " << threads << " threads. Try a larger --hl" << endl;
+        return 0;
+    }
+    double rippleTime = median(times);
+    double efficiency = config.mode == MODE_STRONG ? base.astarTime / rippleTime / threads :
+        (weakBase > 0 ? weakBase / rippleTime : 1);
+    writeRow(out, config, side, seed, threads, "prs", rippleTime, base.astarTime, efficiency, length, base.optimum, 0);
+    return rippleTime;
+}
+
+int main(int argc, char** argv) {
+    ScaleConfig config;
+    config.mode = MODE_STRONG;
+    config.side = 2048;
+    config.ratio = .2;
+    config.hlSide = 16;
+    config.seeds.push_back(3);
+    config.minThreads = 3;
+    config.maxThreads = max(3, omp_get_max_threads());
+    config.reps = 3;
+    FILE* out = stdout;
+    for (int arg = 1; arg < argc; arg++) {
+        if (arg+1 >= argc) {
+            cout << "Missing value for " << argv[arg] << endl << flush;
+            return 0;
+        }
+        if (strcmp(argv[arg], "--mode") == 0) {
+            arg++;
+            if (strcmp(argv[arg], "strong") == 0) config.mode = MODE_STRONG;
+            else if (strcmp(argv[arg], "weak") == 0) config.mode = MODE_WEAK;
+            else {
+                cout << "--mode takes strong or weak, not " << argv[arg] << endl << flush;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "--side") == 0) config.side = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "--ratio") == 0) config.ratio = atof(argv[++arg]);
+        else if (strcmp(argv[arg], "--hl") == 0) config.hlSide = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "--seeds") == 0) {
+            config.seeds.clear();
+            for (char* p = strtok(argv[++arg], ","); p != NULL; p = strtok(NULL, ",")) config.seeds.push_back(atoi(p));
+        }
+        else if (strcmp(argv[arg], "--min") == 0) config.minThreads = max(2, atoi(argv[++arg]));
+        else if (strcmp(argv[arg], "--max") == 0) config.maxThreads = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "--reps") == 0) config.reps = max(1, atoi(argv[++arg]));
+        else if (strcmp(argv[arg], "--out") == 0) {
+            out = fopen(argv[++arg], "w");
+            if (out == NULL) {
+                cout << "Couldn't open " << argv[arg] << endl << flush;
+                return 0;
+            }
+        }
+        else {
+            cout << "usage: scale [--mode strong|weak] [--side n] [--ratio r] [--hl n] [--seeds a,b] "
+                "[--min threads] [--max threads] [--reps n] [--out file]" << endl << flush;
+            return 0;
+        }
+    }
+    //every thread of a ripple search has to run at once
+    omp_set_dynamic(0);
+
+    fprintf(out, "mode,side,ratio,hl_side,seed,threads,solver,time_s,speedup,efficiency,"
+        "length,optimum,suboptimality,expansions\n");
+    for (size_t s = 0; s < config.seeds.size(); s++) {
+        int seed = config.seeds[s];
+        coord start, goal;
+        Baseline base;
+        //strong scaling searches one map, built and baselined once
+        if (config.mode == MODE_STRONG) {
+            MetaMap* mmap = prepareMap(out, config, config.side, seed, &start, &goal, &base);
+            if (mmap == NULL) continue;
+            for (int threads = config.minThreads; threads <= config.maxThreads; threads++) {
+                runRipple(out, config, mmap, config.side, seed, start, goal, base, threads, 0);
+            }
+            freeMetaMap(mmap);
+            continue;
+        }
+        double weakBase = 0;
+        for (int threads = config.minThreads; threads <= config.maxThreads; threads++) {
+            //keep the side a multiple of the high level side, so the squares stay even
+            int side = (int)(config.side * sqrt(((double)threads) / config.minThreads));
+            side -= side % config.hlSide;
+            MetaMap* mmap = prepareMap(out, config, side, seed, &start, &goal, &base);
+            if (mmap == NULL) continue;
+            double rippleTime = runRipple(out, config, mmap, side, seed, start, goal, base, threads, weakBase);
+            if (threads == config.minThreads) weakBase = rippleTime;
+            freeMetaMap(mmap);
+        }
+    }
+    if (out != stdout) fclose(out);
+    return 0;
+}
@@ -0,0 +1,278 @@
+#include "nodemap.h"
+#include "fringesearch.h"
+#include "mapfile.h"
+#include "engine.h"
+#include "stats.h"
+#include "subgoal.h"
+#include "landmarks.h"
+#include "arena.h"
+#include <stdbool.h>
+
+#include <omp.h>
+
+#include <math.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+//answers a stream of queries against one map. The map is built (or loaded) once, then
+// a pool of workers, alive for the whole stream, takes "sx sy gx gy" lines from the
+// query file (stdin by default) and runs each as a ripple search of its own
+int main(int argc, char** argv) {
+    if (argc < 6) {
+        cout << "usage: serve side ratio hlside seed workers [--map file] [--queries file] "
+            "[--segments k] [--claim lock|cas] [--stats json|csv] [--jps] [--subgoals file] [--alt k] "
+            "[--layout plain|padded|morton] [--budget MB] [--pages small|thp|hugetlb]" << endl << flush;
+        return 0;
+    }
+    int mapSideLen = atoi(argv[1]);
+    double obsRatio = atof(argv[2]);
+    int hlSideLen = atoi(argv[3]);
+    int seed = atoi(argv[4]);
+    int workers = atoi(argv[5]);
+    if (workers < 1) {
+        cout << "Must have at least one worker" << endl << flush;
+        return 0;
+    }
+
+    int claimMode = CLAIM_CAS;
+    char* mapFile = NULL;
+    char* queryFile = NULL;
+    int segments = 2;
+    int statsFormat = -1;
+    int expansion = EXPAND_ALL;
+    char* subgoalFile = NULL;
+    int numLandmarks = 0;
+    int layout = LAYOUT_PLAIN;
+    int64_t tileBudget = 0;
+    int pages = PAGES_SMALL;
+    for (int arg = 6; arg < argc; arg++) {
+        if (strcmp(argv[arg], "--claim") == 0 && arg+1 < argc) {
+            arg++;
+            if (strcmp(argv[arg], "lock") == 0) claimMode = CLAIM_LOCK;
+            else if (strcmp(argv[arg], "cas") == 0) claimMode = CLAIM_CAS;
+            else {
+                cout << "--claim takes lock or cas, not " << argv[arg] << endl << flush;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "--map") == 0 && arg+1 < argc) {
+            mapFile = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--queries") == 0 && arg+1 < argc) {
+            queryFile = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--segments") == 0 && arg+1 < argc) {
+            segments = atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "--stats") == 0 && arg+1 < argc) {
+            arg++;
+            if (strcmp(argv[arg], "json") == 0) statsFormat = STATS_JSON;
+            else if (strcmp(argv[arg], "csv") == 0) statsFormat = STATS_CSV;
+            else {
+                cout << "--stats takes json or csv, not " << argv[arg] << endl << flush;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "--subgoals") == 0 && arg+1 < argc) {
+            subgoalFile = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--alt") == 0 && arg+1 < argc) {
+            numLandmarks = atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "--layout") == 0 && arg+1 < argc) {
+            layout = layoutNamed(argv[++arg]);
+            if (layout == -1) {
+                cout << "--layout takes plain, padded or morton, not " << argv[arg] << endl << flush;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "--budget") == 0 && arg+1 < argc) {
+            tileBudget = atoll(argv[++arg]) * 1024 * 1024;
+        }
+        else if (strcmp(argv[arg], "--pages") == 0 && arg+1 < argc) {
+            pages = pageModeNamed(argv[++arg]);
+            if (pages == -1) {
+                cout << "--pages takes small, thp or hugetlb, not " << argv[arg] << endl << flush;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "--jps") == 0) {
+            expansion = EXPAND_JUMP;
+        }
+        else {
+            cout << "Unknown option " << argv[arg] << endl << flush;
+            return 0;
+        }
+    }
+
+    FILE* queries = stdin;
+    if (queryFile != NULL) {
+        queries = fopen(queryFile, "r");
+        if (queries == NULL) {
+            cout << "Couldn't open " << queryFile << endl << flush;
+            return 0;
+        }
+    }
+
+    setPageMode(pages);
+    double change = obsRatio / log2(1.0 * mapSideLen);
+    MapParams params = {
+        mapSideLen,
+        obsRatio,
+        change,
+        layout,
+        STATE_PAGED, //nothing searches the shared map itself, only the engine's views (see engine.h)
+        tileBudget
+    };
+    MetaMap* mmap = NULL;
+    if (mapFile != NULL) {
+        int fileSeed;
+        int loaded = loadMapFile(mapFile, &params, &fileSeed, &mmap);
+        if (loaded == MAPFILE_INVALID) {
+            cout << "Not building a map over " << mapFile << ", give --map a map file or a path with nothing there" << endl << flush;
+            return 1;
+        }
+        if (loaded == MAPFILE_LOADED) {
+            cout << "Loaded map from " << mapFile << endl << flush;
+        }
+    }
+    if (mmap == NULL) {
+        mmap = buildMap(params, seed, hlSideLen);
+        if (mapFile != NULL && saveMapFile(mapFile, mmap, params, seed)) {
+            cout << "Saved map to " << mapFile << endl << flush;
+            //only a mapped file's obstacles can be paged, so with a budget carry on with the
+            // file just written rather than the map built in memory
+            MetaMap* saved = NULL;
+            int fileSeed;
+            if (tileBudget > 0 && loadMapFile(mapFile, &params, &fileSeed, &saved) == MAPFILE_LOADED) {
+                freeMetaMap(mmap);
+                mmap = saved;
+                cout << "Reopened " << mapFile << " to page its obstacles" << endl << flush;
+            }
+        }
+    }
+    if (tileBudget > 0 && mmap->real->tiles == NULL) {
+        cout << "Warn: --budget only pages the obstacles of a --map file, keeping all of them in memory" << endl << flush;
+    }
+    mmap->claimMode = claimMode;
+    mmap->expansion = expansion;
+    //the engine's views share them with the real map
+    if (numLandmarks > 0) {
+        double buildStart = omp_get_wtime();
+        mmap->landmarks = buildLandmarks(*mmap->real, numLandmarks);
+        cout << "Built " << numLandmarks << " landmarks in " << omp_get_wtime() - buildStart << "s" << endl << flush;
+    }
+
+    Engine* engine = buildEngine(mmap, workers, segments);
+    cout << "Components: " << engine->components->count << ", " << engine->components->bits <<
+        " bits per cell" << endl << flush;
+
+    //the subgoal graph is loaded from its file, or built and saved there
+    SubgoalGraph* subgoals = NULL;
+    if (subgoalFile != NULL) {
+        subgoals = loadSubgoalGraph(subgoalFile, *mmap->real);
+        if (subgoals != NULL) {
+            cout << "Loaded subgoal graph from " << subgoalFile << endl << flush;
+        }
+        else {
+            double buildStart = omp_get_wtime();
+            omp_set_num_threads(workers);
+            subgoals = buildSubgoalGraph(*mmap->real, DEFAULT_SUBGOAL_REACH);
+            cout << "Built subgoal graph in " << omp_get_wtime() - buildStart << "s" << endl << flush;
+            if (saveSubgoalGraph(subgoalFile, subgoals, *mmap->real)) {
+                cout << "Saved subgoal graph to " << subgoalFile << endl << flush;
+            }
+        }
+        cout << "Subgoals: " << subgoals->count << ", edges " << subgoals->edgeStart[subgoals->count] << endl << flush;
+        attachSubgoals(engine, subgoals);
+    }
+    cout << "Serving " << mmap->real->cols << " map with " << workers << " workers, " <<
+        engine->segments << " segments per query" << endl << flush;
+
+    vector<double> latencies;
+    int answered = 0;
+    int counts[QUERY_UNREACHABLE + 1] = {0};
+    omp_lock_t inputLock;
+    omp_init_lock(&inputLock);
+
+    resetStats();
+    double startTime = omp_get_wtime();
+    #pragma omp parallel num_threads(workers)
+    {
+        int id = omp_get_thread_num();
+        while (true) {
+            coord start, goal;
+            int query;
+            omp_set_lock(&inputLock);
+            int read = fscanf(queries, "%d %d %d %d", &start.x, &start.y, &goal.x, &goal.y);
+            query = answered++;
+            omp_unset_lock(&inputLock);
+            if (read != 4) break;
+
+            //a worker's queries run on its own thread, so its counters and faults are the query's
+            ThreadStats before = *threadStats();
+            struct rusage usageBefore;
+            getrusage(RUSAGE_THREAD, &usageBefore);
+
+            list<coord>* path;
+            double queryStart = omp_get_wtime();
+            int status = runQuery(engine, id, start, goal, &path);
+            double latency = omp_get_wtime() - queryStart;
+
+            struct rusage usage;
+            getrusage(RUSAGE_THREAD, &usage);
+
+            #pragma omp critical (serveReport)
+            {
+                counts[status]++;
+                latencies.push_back(latency);
+                cout << "query " << query << " " << start.x << " " << start.y << " " <<
+                    goal.x << " " << goal.y << " " << queryStatusName(status) <<
+                    " length " << (path != NULL ? (int)path->size() : 0) <<
+                    " latency " << latency;
+                if (mmap->real->tiles != NULL) {
+                    cout << " tile_hits " << threadStats()->tileHits - before.tileHits <<
+                        " tile_misses " << threadStats()->tileMisses - before.tileMisses <<
+                        " tiles_prefetched " << threadStats()->tilesPrefetched - before.tilesPrefetched <<
+                        " faults " << usage.ru_minflt - usageBefore.ru_minflt <<
+                        " major_faults " << usage.ru_majflt - usageBefore.ru_majflt;
+                }
+                cout << endl;
+            }
+            delete path;
+        }
+    }
+    double totalTime = omp_get_wtime() - startTime;
+    omp_destroy_lock(&inputLock);
+    if (queries != stdin) fclose(queries);
+
+    int total = latencies.size();
+    cout << "Queries: " << total << " (ok " << counts[QUERY_OK] << ", blocked " << counts[QUERY_BLOCKED] <<
+        ", unreachable " << counts[QUERY_UNREACHABLE] << ", no_hl_path " << counts[QUERY_NO_HL] <<
+        ", failed " << counts[QUERY_FAILED] << ")" << endl;
+    cout << "Time: " << totalTime << endl;
+    if (total > 0) {
+        sort(latencies.begin(), latencies.end());
+        double sum = 0;
+        for (int i = 0; i < total; i++) sum += latencies[i];
+        cout << "Throughput: " << total / totalTime << " queries/s" << endl;
+        cout << "Latency mean " << sum / total << " p50 " << latencies[total / 2] <<
+            " p99 " << latencies[min(total - 1, (int)(total * 0.99))] << endl;
+    }
+
+    if (statsFormat != -1) {
+        writeStats(stdout, workers, statsFormat);
+    }
+
+    freeEngine(engine);
+    if (subgoals != NULL) freeSubgoalGraph(subgoals);
+    if (mmap->landmarks != NULL) freeLandmarks(mmap->landmarks);
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <string.h>
+
+#include "stats.h"
+
+ThreadStats statsTable[MAX_STAT_THREADS];
+
+void resetStats() {
+	memset(statsTable, 0, sizeof(statsTable));
+}
+
+static void sumStats(ThreadStats& total, int threads) {
+	memset(&total, 0, sizeof(total));
+	for (int t = 0; t < threads; t++) {
+#define STAT_ADD(name) total.name += statsTable[t].name;
+		STAT_FIELDS(STAT_ADD)
+#undef STAT_ADD
+	}
+}
+
+static void writeJsonEntry(FILE* out, ThreadStats& s) {
+	const char* sep = "";
+	fprintf(out, "{");
+#define STAT_JSON(name) fprintf(out, "%s\"" #name "\": %llu", sep, (unsigned long long)s.name); sep = ", ";
+	STAT_FIELDS(STAT_JSON)
+#undef STAT_JSON
+	fprintf(out, "}");
+}
+
+static void writeCsvRow(FILE* out, const char* label, ThreadStats& s) {
+	fprintf(out, "%s", label);
+#define STAT_CSV(name) fprintf(out, ",%llu", (unsigned long long)s.name);
+	STAT_FIELDS(STAT_CSV)
+#undef STAT_CSV
+	fprintf(out, "\n");
+}
+
+void writeStats(FILE* out, int threads, int format) {
+	if (threads > MAX_STAT_THREADS) threads = MAX_STAT_THREADS;
+	ThreadStats total;
+	sumStats(total, threads);
+
+	if (format == STATS_CSV) {
+		fprintf(out, "thread");
+#define STAT_HEADER(name) fprintf(out, "," #name);
+		STAT_FIELDS(STAT_HEADER)
+#undef STAT_HEADER
+		fprintf(out, "\n");
+		char label[16];
+		for (int t = 0; t < threads; t++) {
+			snprintf(label, sizeof(label), "%d", t);
+			writeCsvRow(out, label, statsTable[t]);
+		}
+		writeCsvRow(out, "total", total);
+	}
+	else {
+		fprintf(out, "{\"enabled\": %s, \"threads\": [", statsEnabled ? "true" : "false");
+		for (int t = 0; t < threads; t++) {
+			fprintf(out, t == 0 ? "\n  " : ",\n  ");
+			writeJsonEntry(out, statsTable[t]);
+		}
+		fprintf(out, "],\n \"total\": ");
+		writeJsonEntry(out, total);
+		fprintf(out, "}\n");
+	}
+	fflush(out);
+}
@@ -0,0 +1,62 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <omp.h>
+
+#ifndef STATS_H
+#define STATS_H
+
+//build with -DPRS_STATS=0 (make STATS=0) to compile every counter out. statsEnabled is a
+// compile time constant, so "if (statsEnabled)" costs nothing when it's off
+#ifndef PRS_STATS
+#define PRS_STATS 1
+#endif
+static const bool statsEnabled = PRS_STATS;
+
+#define MAX_STAT_THREADS 256
+
+//every counter, in report order. Times are in nanoseconds
+#define STAT_FIELDS(X) \
+	X(expanded)         /*nodes expanded by fsearch*/ \
+	X(deferred)         /*nodes moved from now to later, over the threshold*/ \
+	X(thresholdBumps)   /*times now ran dry and later took its place*/ \
+	X(duplicates)       /*cheaper paths to nodes already waiting in the fringe*/ \
+	X(casRetries)       /*claims that lost a compare-and-swap and had to look again*/ \
+	X(lockAcquisitions) /*lockFor locks taken (--claim lock)*/ \
+	X(lockContended)    /*of those, how many were held by another thread*/ \
+	X(lockWaitNs)       /*time spent waiting for contended locks*/ \
+	X(collisions)       /*children found owned by another instance*/ \
+	X(goalsMet)         /*collisions that gave a segment its path to a goal*/ \
+	X(idleWaits)        /*timed waits of a thread looking for work*/ \
+	X(idleNs)           /*time spent looking for work*/ \
+	X(steals)           /*helper instances received from another thread*/ \
+	X(tileHits)         /*moves to a tile of a tiled map (see tiledfile.h) that was resident*/ \
+	X(tileMisses)       /*moves to one that had to be faulted back in*/ \
+	X(tilesDropped)     /*tiles dropped to stay within the budget*/ \
+	X(tilesPrefetched)  /*tiles asked for ahead of the search*/
+
+//one per thread, each on its own cache lines so counting never shares a line
+struct ThreadStats {
+#define STAT_MEMBER(name) uint64_t name;
+	STAT_FIELDS(STAT_MEMBER)
+#undef STAT_MEMBER
+} __attribute__((aligned(64)));
+
+extern ThreadStats statsTable[MAX_STAT_THREADS];
+
+//the calling thread's counters. Hot loops should look this up once, not per event
+inline ThreadStats* threadStats() {
+	return &statsTable[omp_get_thread_num() % MAX_STAT_THREADS];
+}
+
+inline uint64_t statsClockNs() {
+	return (uint64_t)(omp_get_wtime() * 1e9);
+}
+
+void resetStats();
+
+#define STATS_JSON 0
+#define STATS_CSV  1
+//one entry per thread for the first threads threads, and their total
+void writeStats(FILE* out, int threads, int format);
+
+#endif
@@ -0,0 +1,771 @@
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "subgoal.h"
+#include "fringesearch.h"
+
+static bool openCell(Map& map, int x, int y) {
+	return validX(map, x) && validY(map, y) && !isBlocked(map, x, y);
+}
+
+static bool blockedCell(Map& map, int x, int y) {
+	return validX(map, x) && validY(map, y) && isBlocked(map, x, y);
+}
+
+//a free cell at the convex corner of an obstacle
+static bool cornerCell(Map& map, int x, int y) {
+	if (isBlocked(map, x, y)) return false;
+	for (int dx = -1; dx <= 1; dx += 2) {
+		for (int dy = -1; dy <= 1; dy += 2) {
+			if (blockedCell(map, x + dx, y + dy) && openCell(map, x + dx, y) && openCell(map, x, y + dy)) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static bool marked(uint64_t* marks, NodeId node) {
+	return (marks[node >> 6] >> (node & 63)) & 1;
+}
+
+//every word is computed by one thread, so no bit is ever shared
+static uint64_t* markSubgoals(Map& map) {
+	NodeId words = bitsetWords(map);
+	NodeId cells = map.cells;
+	uint64_t* marks = (uint64_t*) calloc(words, sizeof(uint64_t));
+	#pragma omp parallel for schedule(static)
+	for (NodeId w = 0; w < words; w++) {
+		uint64_t bits = 0;
+		for (int b = 0; b < 64 && w * 64 + b < cells; b++) {
+			coord c = coordOf(map, w * 64 + b);
+			if (cornerCell(map, c.x, c.y)) bits |= ((uint64_t)1) << b;
+		}
+		marks[w] = bits;
+	}
+	return marks;
+}
+
+static uint64_t hashObstacles(Map& map) {
+	uint64_t hash = 0;
+	NodeId words = bitsetWords(map);
+	#pragma omp parallel for reduction(^:hash)
+	for (NodeId w = 0; w < words; w++) {
+		hash ^= mixKey(map.blocked[w], w);
+	}
+	return hash;
+}
+
+//sweep states of a cell
+#define UNREACHED 0
+#define CLEAN     1 //reached, and no monotone path from the origin to it passes a subgoal
+#define SHADOWED  2 //reached, but some monotone path to it passes a subgoal
+
+//explores the monotone paths from origin into each quadrant, up to reach cells along either
+// axis. found collects the subgoals reached cleanly (direct-h-reachable): the others
+// are shadowed by a subgoal in between, and an edge to that subgoal covers them.
+//target, if given and reached at all, sets hitTarget. prev and cur are scratch rows
+static void sweep(Map& map, uint64_t* marks, coord origin, int reach, vector<NodeId>& found,
+                  coord* target, bool* hitTarget, vector<char>& prev, vector<char>& cur) {
+	prev.resize(reach + 1);
+	cur.resize(reach + 1);
+	for (int sx = -1; sx <= 1; sx += 2) {
+		for (int sy = -1; sy <= 1; sy += 2) {
+			//how far the target is into this quadrant, if it's in it within reach
+			int ti = -1, tj = -1;
+			if (target != NULL && (target->x - origin.x) * sx >= 0 && (target->y - origin.y) * sy >= 0 &&
+			    abs(target->x - origin.x) <= reach && abs(target->y - origin.y) <= reach) {
+				ti = (target->x - origin.x) * sx;
+				tj = (target->y - origin.y) * sy;
+			}
+			for (int i = 0; i <= reach; i++) {
+				int x = origin.x + i * sx;
+				if (!validX(map, x)) break;
+				bool clean = false;
+				bool reached = false;
+				for (int j = 0; j <= reach; j++) {
+					int y = origin.y + j * sy;
+					if (!validY(map, y)) {
+						for (; j <= reach; j++) cur[j] = UNREACHED;
+						break;
+					}
+					if (i == 0 && j == 0) {
+						cur[j] = CLEAN;
+						clean = reached = true;
+						continue;
+					}
+					NodeId cell = getNode(map, x, y);
+					int from = max(i > 0 ? prev[j] : UNREACHED, j > 0 ? cur[j-1] : UNREACHED);
+					if (isBlocked(map, cell) || from == UNREACHED) {
+						cur[j] = UNREACHED;
+						continue;
+					}
+					if (i == ti && j == tj) *hitTarget = true;
+					if (marked(marks, cell)) {
+						if (from == CLEAN) found.push_back(cell);
+						from = SHADOWED; //everything past a subgoal is reached through it
+					}
+					cur[j] = from;
+					reached = true;
+					if (from == CLEAN) clean = true;
+				}
+				//shadowed cells only matter for shadowing the cells after them, or on the way
+				// to the target
+				if (!reached || (!clean && i >= ti)) break;
+				swap(prev, cur);
+			}
+		}
+	}
+	sort(found.begin(), found.end());
+	found.erase(unique(found.begin(), found.end()), found.end());
+}
+
+//the subgoal on cell, -1 if there is none
+static int32_t subgoalId(SubgoalGraph* graph, NodeId cell) {
+	uint64_t bits = graph->marks[cell >> 6];
+	uint64_t bit = ((uint64_t)1) << (cell & 63);
+	if ((bits & bit) == 0) return -1;
+	return graph->byCell[graph->marksBefore[cell >> 6] + __builtin_popcountll(bits & (bit - 1))];
+}
+
+//the subgoals' cells in ascending order, which is how they are numbered until contraction
+static void collectSubgoals(SubgoalGraph* graph, Map& map) {
+	NodeId words = bitsetWords(map);
+	int64_t count = 0;
+	for (NodeId w = 0; w < words; w++) count += __builtin_popcountll(graph->marks[w]);
+	graph->count = count;
+	graph->cells = (NodeId*) malloc(max((int64_t)1, count) * sizeof(NodeId));
+	int64_t next = 0;
+	for (NodeId w = 0; w < words; w++) {
+		uint64_t bits = graph->marks[w];
+		while (bits != 0) {
+			graph->cells[next++] = w * 64 + __builtin_ctzll(bits);
+			bits &= bits - 1;
+		}
+	}
+}
+
+//coordinates and cell lookup for the subgoals as they are numbered in cells
+static void locateSubgoals(SubgoalGraph* graph, Map& map) {
+	NodeId words = bitsetWords(map);
+	graph->marksBefore = (int64_t*) malloc(words * sizeof(int64_t));
+	int64_t before = 0;
+	for (NodeId w = 0; w < words; w++) {
+		graph->marksBefore[w] = before;
+		before += __builtin_popcountll(graph->marks[w]);
+	}
+	graph->coords = (coord*) malloc(max((int64_t)1, graph->count) * sizeof(coord));
+	graph->byCell = (int32_t*) malloc(max((int64_t)1, graph->count) * sizeof(int32_t));
+	#pragma omp parallel for schedule(static)
+	for (int64_t s = 0; s < graph->count; s++) {
+		NodeId cell = graph->cells[s];
+		graph->coords[s] = coordOf(map, cell);
+		uint64_t bit = ((uint64_t)1) << (cell & 63);
+		graph->byCell[graph->marksBefore[cell >> 6] + __builtin_popcountll(graph->marks[cell >> 6] & (bit - 1))] = s;
+	}
+}
+
+//an edge of the graph while it is being contracted, shortcuts remember the subgoal they
+// were made over
+struct Arc {
+	int32_t to;
+	int cost;
+	int32_t middle;
+};
+
+//witness searches give up after settling this many subgoals, and a pair of neighbors
+// they didn't connect gets a shortcut it may not have needed
+#define WITNESS_SETTLE_LIMIT 500
+
+//per thread Dijkstra scratch for the witness searches
+struct Witness {
+	vector<int> dist;
+	vector<uint32_t> seen;
+	uint32_t stamp;
+	vector<SubgoalEntry> heap;
+};
+
+//ties go to the entry further along
+struct EntryOrder {
+	bool operator()(const SubgoalEntry& a, const SubgoalEntry& b) const {
+		if (a.key != b.key) return a.key > b.key;
+		return a.cost < b.cost;
+	}
+};
+
+//distances from origin over the subgoals not contracted yet, except skip, as far as limit.
+// Only the targets are of interest, so the search stops once they are all settled
+static void witnessSearch(vector< vector<Arc> >& adjacent, int32_t origin, int32_t skip, int limit,
+                          int targets, vector<char>& target, Witness& w) {
+	if (++w.stamp == 0) {
+		fill(w.seen.begin(), w.seen.end(), 0);
+		w.stamp = 1;
+	}
+	w.heap.clear();
+	w.seen[origin] = w.stamp;
+	w.dist[origin] = 0;
+	SubgoalEntry first = {0, 0, origin};
+	w.heap.push_back(first);
+	int settled = 0;
+	while (!w.heap.empty() && targets > 0 && settled < WITNESS_SETTLE_LIMIT) {
+		SubgoalEntry top = w.heap.front();
+		pop_heap(w.heap.begin(), w.heap.end(), EntryOrder());
+		w.heap.pop_back();
+		if (top.cost > w.dist[top.node]) continue;
+		if (top.cost > limit) break;
+		settled++;
+		if (target[top.node]) targets--;
+		vector<Arc>& arcs = adjacent[top.node];
+		for (size_t e = 0; e < arcs.size(); e++) {
+			int32_t next = arcs[e].to;
+			int cost = top.cost + arcs[e].cost;
+			if (next == skip || cost > limit) continue;
+			if (w.seen[next] == w.stamp && w.dist[next] <= cost) continue;
+			w.seen[next] = w.stamp;
+			w.dist[next] = cost;
+			SubgoalEntry entry = {cost, cost, next};
+			w.heap.push_back(entry);
+			push_heap(w.heap.begin(), w.heap.end(), EntryOrder());
+		}
+	}
+}
+
+//the shortcuts contracting v takes: one between each pair of its neighbors whose shortest
+// path runs through v. Appended to shortcuts as (from, to, cost) triples
+static void shortcutsFor(vector< vector<Arc> >& adjacent, int32_t v, Witness& w,
+                         vector<char>& target, vector<int>& shortcuts) {
+	vector<Arc>& arcs = adjacent[v];
+	int farthest = 0;
+	for (size_t i = 0; i < arcs.size(); i++) farthest = max(farthest, arcs[i].cost);
+	for (size_t i = 0; i + 1 < arcs.size(); i++) {
+		for (size_t j = i + 1; j < arcs.size(); j++) target[arcs[j].to] = 1;
+		witnessSearch(adjacent, arcs[i].to, v, arcs[i].cost + farthest, arcs.size() - 1 - i, target, w);
+		for (size_t j = i + 1; j < arcs.size(); j++) {
+			int32_t to = arcs[j].to;
+			int through = arcs[i].cost + arcs[j].cost;
+			target[to] = 0;
+			if (w.seen[to] == w.stamp && w.dist[to] <= through) continue;
+			shortcuts.push_back(arcs[i].to);
+			shortcuts.push_back(to);
+			shortcuts.push_back(through);
+		}
+	}
+}
+
+//lower contracts earlier: subgoals whose removal adds fewer edges than it takes away, and
+// whose neighbors haven't lost many already, so the hierarchy stays shallow
+static int contractionPriority(vector< vector<Arc> >& adjacent, vector<int>& removedNeighbors,
+                               int32_t v, Witness& w, vector<char>& target, vector<int>& shortcuts) {
+	shortcuts.clear();
+	shortcutsFor(adjacent, v, w, target, shortcuts);
+	return 2 * ((int)shortcuts.size() / 3 - (int)adjacent[v].size()) + removedNeighbors[v];
+}
+
+static void addArc(vector<Arc>& arcs, int32_t to, int cost, int32_t middle) {
+	for (size_t e = 0; e < arcs.size(); e++) {
+		if (arcs[e].to != to) continue;
+		if (cost < arcs[e].cost) {
+			arcs[e].cost = cost;
+			arcs[e].middle = middle;
+		}
+		return;
+	}
+	Arc arc = {to, cost, middle};
+	arcs.push_back(arc);
+}
+
+static void removeArc(vector<Arc>& arcs, int32_t to) {
+	for (size_t e = 0; e < arcs.size(); e++) {
+		if (arcs[e].to == to) {
+			arcs[e] = arcs.back();
+			arcs.pop_back();
+			return;
+		}
+	}
+}
+
+//contracts the graph given as adjacency lists (both directions of every edge), renumbers
+// the subgoals in contraction order and keeps each one's edges to those after it
+static void contract(SubgoalGraph* graph, vector< vector<Arc> >& adjacent) {
+	int64_t count = graph->count;
+	vector<int> removedNeighbors(count, 0);
+	vector<int> priority(count);
+
+	//the first priorities are independent of each other, later ones are only refreshed
+	// when a subgoal comes up (lazily), which is where the order is decided
+	#pragma omp parallel
+	{
+		Witness w;
+		w.dist.resize(count);
+		w.seen.assign(count, 0);
+		w.stamp = 0;
+		vector<char> target(count, 0);
+		vector<int> shortcuts;
+		#pragma omp for schedule(dynamic, 1024)
+		for (int64_t v = 0; v < count; v++) {
+			priority[v] = contractionPriority(adjacent, removedNeighbors, v, w, target, shortcuts);
+		}
+	}
+
+	Witness w;
+	w.dist.resize(count);
+	w.seen.assign(count, 0);
+	w.stamp = 0;
+	vector<char> target(count, 0);
+	vector<int> shortcuts;
+	vector< pair<int, int32_t> > queue;
+	for (int64_t v = 0; v < count; v++) queue.push_back(make_pair(-priority[v], (int32_t)v));
+	make_heap(queue.begin(), queue.end());
+	vector< vector<Arc> > upward(count);
+	vector<int32_t> order(count); //new number of each subgoal
+	int32_t next = 0;
+	while (!queue.empty()) {
+		int32_t v = queue.front().second;
+		pop_heap(queue.begin(), queue.end());
+		queue.pop_back();
+		int now = contractionPriority(adjacent, removedNeighbors, v, w, target, shortcuts);
+		if (!queue.empty() && now > -queue.front().first) {
+			queue.push_back(make_pair(-now, v));
+			push_heap(queue.begin(), queue.end());
+			continue;
+		}
+		order[v] = next++;
+		for (size_t s = 0; s < shortcuts.size(); s += 3) {
+			addArc(adjacent[shortcuts[s]], shortcuts[s+1], shortcuts[s+2], v);
+			addArc(adjacent[shortcuts[s+1]], shortcuts[s], shortcuts[s+2], v);
+		}
+		vector<Arc>& arcs = adjacent[v];
+		for (size_t e = 0; e < arcs.size(); e++) {
+			removeArc(adjacent[arcs[e].to], v);
+			removedNeighbors[arcs[e].to]++;
+		}
+		upward[v].swap(arcs);
+	}
+
+	vector<int32_t> byOrder(count);
+	for (int64_t v = 0; v < count; v++) byOrder[order[v]] = v;
+	NodeId* cells = (NodeId*) malloc(max((int64_t)1, count) * sizeof(NodeId));
+	for (int64_t n = 0; n < count; n++) cells[n] = graph->cells[byOrder[n]];
+	free(graph->cells);
+	graph->cells = cells;
+
+	graph->edgeStart = (int64_t*) malloc((count + 1) * sizeof(int64_t));
+	graph->edgeStart[0] = 0;
+	for (int64_t n = 0; n < count; n++) {
+		graph->edgeStart[n+1] = graph->edgeStart[n] + upward[byOrder[n]].size();
+	}
+	int64_t edges = max((int64_t)1, graph->edgeStart[count]);
+	graph->edgeTo = (int32_t*) malloc(edges * sizeof(int32_t));
+	graph->edgeCost = (int*) malloc(edges * sizeof(int));
+	graph->edgeMiddle = (int32_t*) malloc(edges * sizeof(int32_t));
+	#pragma omp parallel for schedule(static)
+	for (int64_t n = 0; n < count; n++) {
+		vector<Arc>& arcs = upward[byOrder[n]];
+		for (size_t e = 0; e < arcs.size(); e++) {
+			graph->edgeTo[graph->edgeStart[n] + e] = order[arcs[e].to];
+			graph->edgeCost[graph->edgeStart[n] + e] = arcs[e].cost;
+			graph->edgeMiddle[graph->edgeStart[n] + e] = arcs[e].middle == -1 ? -1 : order[arcs[e].middle];
+		}
+	}
+}
+
+SubgoalGraph* buildSubgoalGraph(Map& map, int reach) {
+	SubgoalGraph* graph = (SubgoalGraph*) malloc(sizeof(SubgoalGraph));
+	graph->reach = reach;
+	graph->marks = markSubgoals(map);
+	graph->mapHash = hashObstacles(map);
+	collectSubgoals(graph, map);
+	locateSubgoals(graph, map);
+
+	//every subgoal sweeps on its own, then each edge is listed at both of its ends
+	vector< vector<int32_t> > found(graph->count);
+	#pragma omp parallel
+	{
+		vector<NodeId> cells;
+		vector<char> prev, cur;
+		#pragma omp for schedule(dynamic, 256)
+		for (int64_t s = 0; s < graph->count; s++) {
+			cells.clear();
+			sweep(map, graph->marks, graph->coords[s], reach, cells, NULL, NULL, prev, cur);
+			for (size_t f = 0; f < cells.size(); f++) found[s].push_back(subgoalId(graph, cells[f]));
+		}
+	}
+	vector<size_t> swept(graph->count);
+	for (int64_t s = 0; s < graph->count; s++) swept[s] = found[s].size();
+	for (int64_t s = 0; s < graph->count; s++) {
+		for (size_t f = 0; f < swept[s]; f++) found[found[s][f]].push_back(s);
+	}
+	vector< vector<Arc> > adjacent(graph->count);
+	#pragma omp parallel for schedule(dynamic, 256)
+	for (int64_t s = 0; s < graph->count; s++) {
+		sort(found[s].begin(), found[s].end());
+		found[s].erase(unique(found[s].begin(), found[s].end()), found[s].end());
+		for (size_t f = 0; f < found[s].size(); f++) {
+			int32_t to = found[s][f];
+			Arc arc = {to, manhattan(graph->coords[s], graph->coords[to]), -1};
+			adjacent[s].push_back(arc);
+		}
+		vector<int32_t>().swap(found[s]);
+	}
+	contract(graph, adjacent);
+	free(graph->coords);
+	free(graph->marksBefore);
+	free(graph->byCell);
+	locateSubgoals(graph, map);
+	return graph;
+}
+
+void freeSubgoalGraph(SubgoalGraph* graph) {
+	free(graph->cells);
+	free(graph->coords);
+	free(graph->marksBefore);
+	free(graph->byCell);
+	free(graph->edgeStart);
+	free(graph->edgeTo);
+	free(graph->edgeCost);
+	free(graph->edgeMiddle);
+	free(graph->marks);
+	free(graph);
+}
+
+//file layout: header, cells, edgeStart, edgeTo, edgeCost, edgeMiddle. The marks are rebuilt
+// from the map on load
+struct SubgoalFileHeader {
+	char magic[8];
+	uint32_t version;
+	int32_t reach;
+	int32_t rows;
+	int32_t cols;
+	int64_t count;
+	int64_t edges;
+	uint64_t mapHash;
+};
+
+//returns 1 on success
+int saveSubgoalGraph(const char* filename, SubgoalGraph* graph, Map& map) {
+	SubgoalFileHeader header;
+	memset(&header, 0, sizeof(header));
+	strncpy(header.magic, SUBGOAL_MAGIC, sizeof(header.magic));
+	header.version = SUBGOAL_VERSION;
+	header.reach = graph->reach;
+	header.rows = map.rows;
+	header.cols = map.cols;
+	header.count = graph->count;
+	header.edges = graph->edgeStart[graph->count];
+	header.mapHash = graph->mapHash;
+
+	FILE* fp = fopen(filename, "wb");
+	if (fp == NULL) {
+		printf("Couldn't open %s for writing\n", filename);
+		return 0;
+	}
+	int ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+	         fwrite(graph->cells, sizeof(NodeId), header.count, fp) == (size_t)header.count &&
+	         fwrite(graph->edgeStart, sizeof(int64_t), header.count + 1, fp) == (size_t)header.count + 1 &&
+	         fwrite(graph->edgeTo, sizeof(int32_t), header.edges, fp) == (size_t)header.edges &&
+	         fwrite(graph->edgeCost, sizeof(int), header.edges, fp) == (size_t)header.edges &&
+	         fwrite(graph->edgeMiddle, sizeof(int32_t), header.edges, fp) == (size_t)header.edges;
+	if (fclose(fp) != 0) ok = 0;
+	if (!ok) printf("Failed writing %s\n", filename);
+	return ok;
+}
+
+//returns NULL if the file is missing, damaged, or was built for a different map
+SubgoalGraph* loadSubgoalGraph(const char* filename, Map& map) {
+	FILE* fp = fopen(filename, "rb");
+	if (fp == NULL) return NULL;
+	SubgoalFileHeader header;
+	if (fread(&header, sizeof(header), 1, fp) != 1 ||
+	    strncmp(header.magic, SUBGOAL_MAGIC, sizeof(header.magic)) != 0 ||
+	    header.version != SUBGOAL_VERSION) {
+		printf("%s isn't a version %d subgoal file\n", filename, SUBGOAL_VERSION);
+		fclose(fp);
+		return NULL;
+	}
+	if (header.rows != map.rows || header.cols != map.cols || header.mapHash != hashObstacles(map)) {
+		printf("%s was built for a different map\n", filename);
+		fclose(fp);
+		return NULL;
+	}
+	uint64_t* marks = markSubgoals(map);
+	int64_t subgoals = 0;
+	for (NodeId w = 0; w < bitsetWords(map); w++) subgoals += __builtin_popcountll(marks[w]);
+	fseek(fp, 0, SEEK_END);
+	int64_t fileBytes = ftell(fp);
+	fseek(fp, sizeof(header), SEEK_SET);
+	if (header.count != subgoals || header.reach < 1 || header.edges < 0 ||
+	    header.edges > (fileBytes - (int64_t)sizeof(header)) / 12 ||
+	    fileBytes != (int64_t)sizeof(header) + header.count * 16 + 8 + header.edges * 12) {
+		printf("%s is damaged\n", filename);
+		free(marks);
+		fclose(fp);
+		return NULL;
+	}
+
+	SubgoalGraph* graph = (SubgoalGraph*) malloc(sizeof(SubgoalGraph));
+	graph->count = header.count;
+	graph->reach = header.reach;
+	graph->mapHash = header.mapHash;
+	graph->marks = marks;
+	graph->cells = (NodeId*) malloc(max((int64_t)1, header.count) * sizeof(NodeId));
+	graph->edgeStart = (int64_t*) malloc((header.count + 1) * sizeof(int64_t));
+	graph->edgeTo = (int32_t*) malloc(max((int64_t)1, header.edges) * sizeof(int32_t));
+	graph->edgeCost = (int*) malloc(max((int64_t)1, header.edges) * sizeof(int));
+	graph->edgeMiddle = (int32_t*) malloc(max((int64_t)1, header.edges) * sizeof(int32_t));
+	int ok = fread(graph->cells, sizeof(NodeId), header.count, fp) == (size_t)header.count &&
+	         fread(graph->edgeStart, sizeof(int64_t), header.count + 1, fp) == (size_t)header.count + 1 &&
+	         fread(graph->edgeTo, sizeof(int32_t), header.edges, fp) == (size_t)header.edges &&
+	         fread(graph->edgeCost, sizeof(int), header.edges, fp) == (size_t)header.edges &&
+	         fread(graph->edgeMiddle, sizeof(int32_t), header.edges, fp) == (size_t)header.edges;
+	fclose(fp);
+	graph->coords = NULL;
+	graph->marksBefore = NULL;
+	graph->byCell = NULL;
+	if (!ok) {
+		printf("%s is truncated\n", filename);
+		freeSubgoalGraph(graph);
+		return NULL;
+	}
+	//a query follows whatever the file says, so it has to describe a hierarchy over
+	// exactly the subgoals of this map
+	for (int64_t s = 0; s < graph->count && ok; s++) {
+		NodeId cell = graph->cells[s];
+		ok = cell >= 0 && cell < map.cells && marked(marks, cell);
+	}
+	if (ok) locateSubgoals(graph, map);
+	ok = ok && graph->edgeStart[0] == 0 && graph->edgeStart[graph->count] == header.edges;
+	for (int64_t s = 0; s < graph->count && ok; s++) {
+		ok = subgoalId(graph, graph->cells[s]) == s && graph->edgeStart[s] <= graph->edgeStart[s+1];
+		for (int64_t e = graph->edgeStart[s]; e < graph->edgeStart[s+1] && ok; e++) {
+			ok = graph->edgeTo[e] > s && graph->edgeTo[e] < graph->count && graph->edgeCost[e] > 0 &&
+			     graph->edgeMiddle[e] >= -1 && graph->edgeMiddle[e] < s;
+		}
+	}
+	if (!ok) {
+		printf("%s is damaged\n", filename);
+		freeSubgoalGraph(graph);
+		return NULL;
+	}
+	return graph;
+}
+
+SubgoalSearch* buildSubgoalSearch(SubgoalGraph* graph) {
+	SubgoalSearch* search = new SubgoalSearch();
+	int64_t nodes = graph->count + 2; //the subgoals, then start and goal
+	int64_t box = (int64_t)(graph->reach + 1) * (graph->reach + 1);
+	search->graph = graph;
+	search->labels[0] = (SubgoalLabel*) calloc(nodes, sizeof(SubgoalLabel));
+	search->labels[1] = (SubgoalLabel*) calloc(nodes, sizeof(SubgoalLabel));
+	search->stamp = 0;
+	search->dead = (uint32_t*) calloc(box, sizeof(uint32_t));
+	search->deadStamp = 0;
+	return search;
+}
+
+void freeSubgoalSearch(SubgoalSearch* search) {
+	free(search->labels[0]);
+	free(search->labels[1]);
+	free(search->dead);
+	delete search;
+}
+
+//appends a monotone path from a (exclusive) to b, false if there is none. A depth first
+// walk that heads for b along whichever axis has further to go: in the open it goes
+// straight there, and cells found to be dead ends are remembered so none is tried twice.
+//b has to be within reach of a along both axes, as every edge and sweep hit is
+static bool appendMonotone(Map& map, SubgoalSearch* search, coord a, coord b, list<coord>* path) {
+	int reach = search->graph->reach;
+	if (abs(b.x - a.x) > reach || abs(b.y - a.y) > reach) return false;
+	if (++search->deadStamp == 0) {
+		memset(search->dead, 0, (int64_t)(reach + 1) * (reach + 1) * sizeof(uint32_t));
+		search->deadStamp = 1;
+	}
+	uint32_t stamp = search->deadStamp;
+	int sx = b.x >= a.x ? 1 : -1;
+	int sy = b.y >= a.y ? 1 : -1;
+	vector<coord>& stack = search->walk;
+	stack.assign(1, a);
+	while (!stack.empty()) {
+		coord c = stack.back();
+		if (c == b) break;
+		coord stepX = {c.x + sx, c.y};
+		coord stepY = {c.x, c.y + sy};
+		//cells are told apart by how far they are from a along each axis
+		uint32_t* deadX = search->dead + (int64_t)abs(stepX.x - a.x) * (reach + 1) + abs(stepX.y - a.y);
+		uint32_t* deadY = search->dead + (int64_t)abs(stepY.x - a.x) * (reach + 1) + abs(stepY.y - a.y);
+		bool canX = c.x != b.x && !isBlocked(map, stepX.x, stepX.y) && *deadX != stamp;
+		bool canY = c.y != b.y && !isBlocked(map, stepY.x, stepY.y) && *deadY != stamp;
+		if (canX && (!canY || abs(b.x - c.x) >= abs(b.y - c.y))) {
+			stack.push_back(stepX);
+		}
+		else if (canY) {
+			stack.push_back(stepY);
+		}
+		else {
+			search->dead[(int64_t)abs(c.x - a.x) * (reach + 1) + abs(c.y - a.y)] = stamp;
+			stack.pop_back();
+		}
+	}
+	if (stack.empty()) return false;
+	path->insert(path->end(), stack.begin() + 1, stack.end());
+	return true;
+}
+
+//the edge between two subgoals, kept at whichever of them was contracted first
+static int64_t edgeBetween(SubgoalGraph* graph, int32_t a, int32_t b) {
+	int32_t low = min(a, b);
+	int32_t high = max(a, b);
+	for (int64_t e = graph->edgeStart[low]; e < graph->edgeStart[low + 1]; e++) {
+		if (graph->edgeTo[e] == high) return e;
+	}
+	return -1;
+}
+
+//settles the next node of one side of the query, and relaxes its edges to higher ranked
+// subgoals. The start (side 0) and goal (side 1) reach the subgoals their sweeps found.
+//Each side is an A* towards the other end: every edge, shortcuts too, costs at least the
+// manhattan distance it covers, so a node's key is never more than the cost of the best
+// path over it, and a side has nothing to improve once its keys reach the best meeting
+static void settleNext(SubgoalSearch* search, int side, coord end, coord toward, vector<NodeId>& ends,
+                       int* best, int32_t* meet) {
+	SubgoalGraph* graph = search->graph;
+	vector<SubgoalEntry>& open = search->open[side];
+	SubgoalLabel* labels = search->labels[side];
+	SubgoalLabel* other = search->labels[1 - side];
+	uint32_t stamp = search->stamp;
+	SubgoalEntry top = open.front();
+	pop_heap(open.begin(), open.end(), EntryOrder());
+	open.pop_back();
+	if (top.cost > labels[top.node].cost) return;
+	if (other[top.node].seen == stamp && top.cost + other[top.node].cost < *best) {
+		*best = top.cost + other[top.node].cost;
+		*meet = top.node;
+	}
+
+	bool isEnd = top.node >= graph->count;
+	//a node a higher one reaches more cheaply than this side did is on no shortest path
+	// up from here, so its edges needn't be followed (the higher node's are)
+	if (!isEnd) {
+		for (int64_t e = graph->edgeStart[top.node]; e < graph->edgeStart[top.node + 1]; e++) {
+			SubgoalLabel& above = labels[graph->edgeTo[e]];
+			if (above.seen == stamp && above.cost + graph->edgeCost[e] < top.cost) return;
+		}
+	}
+	int64_t first = isEnd ? 0 : graph->edgeStart[top.node];
+	int64_t last = isEnd ? ends.size() : graph->edgeStart[top.node + 1];
+	for (int64_t e = first; e < last; e++) {
+		int32_t next;
+		int cost = top.cost;
+		if (isEnd) {
+			next = subgoalId(graph, ends[e]);
+			cost += manhattan(end, graph->coords[next]);
+		}
+		else {
+			next = graph->edgeTo[e];
+			cost += graph->edgeCost[e];
+		}
+		int key = cost + manhattan(graph->coords[next], toward);
+		if (key >= *best) continue;
+		SubgoalLabel& label = labels[next];
+		if (label.seen == stamp && label.cost <= cost) continue;
+		label.seen = stamp;
+		label.cost = cost;
+		label.parent = top.node;
+		SubgoalEntry entry = {key, cost, next};
+		open.push_back(entry);
+		push_heap(open.begin(), open.end(), EntryOrder());
+	}
+}
+
+list<coord>* subgoalQuery(Map& map, SubgoalSearch* search, coord start, coord goal) {
+	SubgoalGraph* graph = search->graph;
+	if (!openCell(map, start.x, start.y) || !openCell(map, goal.x, goal.y)) return NULL;
+
+	list<coord>* path = new list<coord>(1, start);
+	if (start == goal) return path;
+
+	//connect start and goal to the graph. A goal reached directly needs no graph at all
+	vector<NodeId>& fromStart = search->fromStart;
+	vector<NodeId>& toGoal = search->toGoal;
+	fromStart.clear();
+	toGoal.clear();
+	bool direct = false;
+	sweep(map, graph->marks, start, graph->reach, fromStart, &goal, &direct, search->prevRow, search->curRow);
+	if (direct && appendMonotone(map, search, start, goal, path)) return path;
+	sweep(map, graph->marks, goal, graph->reach, toGoal, NULL, NULL, search->prevRow, search->curRow);
+
+	int32_t startNode = graph->count;
+	int32_t goalNode = graph->count + 1;
+	if (++search->stamp == 0) {
+		memset(search->labels[0], 0, (graph->count + 2) * sizeof(SubgoalLabel));
+		memset(search->labels[1], 0, (graph->count + 2) * sizeof(SubgoalLabel));
+		search->stamp = 1;
+	}
+	int32_t ends[2] = {startNode, goalNode};
+	for (int side = 0; side < 2; side++) {
+		SubgoalLabel& label = search->labels[side][ends[side]];
+		label.seen = search->stamp;
+		label.cost = 0;
+		label.parent = -1;
+		SubgoalEntry origin = {manhattan(start, goal), 0, ends[side]};
+		search->open[side].assign(1, origin);
+	}
+
+	//upward from both ends, the side with the lower key first. Every shortest path climbs
+	// to its highest subgoal and comes down again, so the sides meet on it
+	int best = INT_MAX;
+	int32_t meet = -1;
+	while (true) {
+		bool going[2];
+		for (int side = 0; side < 2; side++) {
+			going[side] = !search->open[side].empty() && search->open[side].front().key < best;
+		}
+		if (!going[0] && !going[1]) break;
+		int side = !going[0] || (going[1] && search->open[1].front().key < search->open[0].front().key);
+		if (side == 0) settleNext(search, 0, start, goal, fromStart, &best, &meet);
+		else settleNext(search, 1, goal, start, toGoal, &best, &meet);
+	}
+	if (meet == -1) {
+		delete path;
+		return NULL;
+	}
+
+	//the route over the hierarchy, start to goal, with each shortcut then unpacked into the
+	// subgoals it was made over, and each edge between those refined to grid cells
+	vector<int32_t>& route = search->route;
+	route.clear();
+	for (int32_t n = meet; n != -1; n = search->labels[0][n].parent) route.push_back(n);
+	reverse(route.begin(), route.end());
+	for (int32_t n = search->labels[1][meet].parent; n != -1; n = search->labels[1][n].parent) route.push_back(n);
+
+	vector<coord>& points = search->points;
+	points.assign(1, start);
+	vector<int32_t>& unpack = search->unpack;
+	for (size_t r = 1; r < route.size(); r++) {
+		int32_t from = route[r-1];
+		unpack.assign(1, route[r]);
+		//unpack holds what's left of the way from from to route[r], the next step last
+		while (!unpack.empty()) {
+			int32_t to = unpack.back();
+			int64_t e = from < graph->count && to < graph->count ? edgeBetween(graph, from, to) : -1;
+			if (e != -1 && graph->edgeMiddle[e] != -1) {
+				unpack.push_back(graph->edgeMiddle[e]);
+				continue;
+			}
+			points.push_back(to == goalNode ? goal : graph->coords[to]);
+			from = to;
+			unpack.pop_back();
+		}
+	}
+	for (size_t p = 1; p < points.size(); p++) {
+		if (!appendMonotone(map, search, points[p-1], points[p], path)) {
+			delete path;
+			return NULL;
+		}
+	}
+	return path;
+}
@@ -0,0 +1,93 @@
+#include <stdint.h>
+
+#include "nodemap.h"
+
+#ifndef SUBGOAL_H
+#define SUBGOAL_H
+
+#include <list>
+#include <vector>
+
+using namespace std;
+
+//simple subgoal graph over the real map, for answering queries on a static map without
+// searching the grid. On a 4-connected grid shortest paths only need to bend at the convex
+// corners of obstacles, so those cells are the subgoals: free cells with a blocked diagonal
+// neighbor whose two cells in between are free. Two subgoals get an edge if one can reach
+// the other with a monotone (manhattan length) path that doesn't pass another subgoal.
+//Reachability is only explored up to reach cells along each axis, which keeps building
+// cheap on cluttered maps; a query the graph can't connect comes back NULL, and the caller
+// falls back to searching the grid.
+//Manhattan distance can't tell most subgoals of a 4-connected map apart (every monotone
+// path ties), so an A* over the graph ends up expanding the box between start and goal.
+// Instead the graph is contracted into a hierarchy: subgoals are removed one at a time,
+// least important first, and shortcut edges keep the distances between the ones left. A
+// query then only searches upward from either end, each side an A* towards the other,
+// which settles a few hundred subgoals however far apart start and goal are. Only the
+// upward edges are kept
+
+#define SUBGOAL_MAGIC "PRSSUBG"
+#define SUBGOAL_VERSION 2
+#define DEFAULT_SUBGOAL_REACH 256
+
+struct SubgoalGraph {
+	int64_t count;      //subgoals are numbered in the order they were contracted, which packs
+	                    // the top of the hierarchy, where every query goes, together
+	NodeId* cells;      //cell of each subgoal
+	coord* coords;      //and its coordinates, so queries needn't divide
+	int64_t* edgeStart; //edges of subgoal i are edgeTo[edgeStart[i]..edgeStart[i+1]), all to
+	int32_t* edgeTo;    // subgoals numbered above i
+	int* edgeCost;
+	int32_t* edgeMiddle; //subgoal a shortcut was made over, -1 for an edge of the map
+	uint64_t* marks;    //one bit per cell, set on subgoals
+	int64_t* marksBefore; //subgoals marked in the words of marks before each one
+	int32_t* byCell;    //subgoals in the order of their cells, see subgoalId
+	int reach;
+	uint64_t mapHash;   //of the obstacle bitset the graph was built for
+};
+
+struct SubgoalLabel {
+	uint32_t seen; //cost and parent are only valid where seen == the search's stamp
+	int cost;
+	int32_t parent;
+};
+
+struct SubgoalEntry {
+	int key; //cost plus the estimate of what is left, for searches that have one
+	int cost;
+	int32_t node;
+};
+
+//per thread scratch for queries, so a graph can serve any number of threads at once.
+// Everything a query works in is kept here and reused, so answering one allocates
+// nothing but the path it returns
+struct SubgoalSearch {
+	SubgoalGraph* graph;
+	SubgoalLabel* labels[2]; //from the start and from the goal: the subgoals, then start and goal
+	vector<SubgoalEntry> open[2]; //binary heaps
+	uint32_t stamp;
+	vector<NodeId> fromStart, toGoal;
+	vector<char> prevRow, curRow; //of the start and goal sweeps
+	vector<int32_t> route, unpack;
+	vector<coord> points;
+	//appendMonotone's walk, and the dead ends it found: one entry per cell of the
+	// (reach+1)^2 box the walk heads into, dead where it equals deadStamp
+	vector<coord> walk;
+	uint32_t* dead;
+	uint32_t deadStamp;
+};
+
+SubgoalGraph* buildSubgoalGraph(Map& map, int reach);
+void freeSubgoalGraph(SubgoalGraph* graph);
+
+int saveSubgoalGraph(const char* filename, SubgoalGraph* graph, Map& map);
+SubgoalGraph* loadSubgoalGraph(const char* filename, Map& map);
+
+SubgoalSearch* buildSubgoalSearch(SubgoalGraph* graph);
+void freeSubgoalSearch(SubgoalSearch* search);
+
+//a grid path from start to goal, or NULL if the graph doesn't connect them. It's a shortest
+// path as long as reach covers the obstacle free stretches of the map
+list<coord>* subgoalQuery(Map& map, SubgoalSearch* search, coord start, coord goal);
+
+#endif
@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+
+#include "tiledfile.h"
+#include "stats.h"
+
+using namespace std;
+
+//the tile a thread read last, and the generation it read it in
+struct LastTile {
+	TiledFile* file;
+	NodeId tile;
+	uint64_t generation;
+};
+static __thread LastTile lastTile = {NULL, -1, 0};
+
+static uint8_t loadFlags(TiledFile* file, NodeId tile) {
+	return __atomic_load_n(&(file->flags[tile]), __ATOMIC_RELAXED);
+}
+
+static void dropTile(TiledFile* file, NodeId tile) {
+	uint64_t offset = ((uint64_t)tile) * TILED_TILE_BYTES;
+	madvise(file->base + offset, min((uint64_t)TILED_TILE_BYTES, file->bytes - offset), MADV_DONTNEED);
+	__atomic_fetch_and(&(file->flags[tile]), (uint8_t)~TILE_RESIDENT, __ATOMIC_RELAXED);
+	file->residentTiles--;
+	__atomic_add_fetch(&(file->generation), 1, __ATOMIC_RELAXED);
+	if (statsEnabled) threadStats()->tilesDropped++;
+}
+
+//drops tiles until there's room for one more, lock held. A tile is spared once if it was
+// read since the hand last passed it, and pinned tiles (or keep) always are, so with
+// too many of them pinned the budget is exceeded rather than looping forever
+static void makeRoom(TiledFile* file, NodeId keep) {
+	for (NodeId scanned = 0; file->residentTiles >= file->budgetTiles && scanned < 2 * file->tiles; scanned++) {
+		NodeId tile = file->hand;
+		file->hand = (file->hand + 1) % file->tiles;
+		uint8_t flags = loadFlags(file, tile);
+		if (!(flags & TILE_RESIDENT) || (flags & TILE_PINNED) || tile == keep) continue;
+		if (flags & TILE_REFERENCED) {
+			__atomic_fetch_and(&(file->flags[tile]), (uint8_t)~TILE_REFERENCED, __ATOMIC_RELAXED);
+			continue;
+		}
+		dropTile(file, tile);
+	}
+}
+
+//marks tile resident and referenced, with extra flags, lock held. Returns false if it
+// already was resident
+static bool installTile(TiledFile* file, NodeId tile, uint8_t extra) {
+	if (loadFlags(file, tile) & TILE_RESIDENT) {
+		__atomic_fetch_or(&(file->flags[tile]), (uint8_t)(TILE_REFERENCED | extra), __ATOMIC_RELAXED);
+		return false;
+	}
+	makeRoom(file, tile);
+	__atomic_fetch_or(&(file->flags[tile]), (uint8_t)(TILE_RESIDENT | TILE_REFERENCED | extra), __ATOMIC_RELAXED);
+	file->residentTiles++;
+	return true;
+}
+
+//a hit if the tile is still resident, a miss (which will fault) if it has to be brought in
+static void touchTile(TiledFile* file, NodeId tile) {
+	uint8_t flags = loadFlags(file, tile);
+	if (flags & TILE_RESIDENT) {
+		if (!(flags & TILE_REFERENCED)) {
+			__atomic_fetch_or(&(file->flags[tile]), (uint8_t)TILE_REFERENCED, __ATOMIC_RELAXED);
+		}
+		if (statsEnabled) threadStats()->tileHits++;
+	}
+	else {
+		omp_set_lock(&(file->lock));
+		bool missed = installTile(file, tile, 0);
+		omp_unset_lock(&(file->lock));
+		if (statsEnabled) {
+			if (missed) threadStats()->tileMisses++;
+			else threadStats()->tileHits++;
+		}
+	}
+	lastTile.file = file;
+	lastTile.tile = tile;
+	lastTile.generation = __atomic_load_n(&(file->generation), __ATOMIC_RELAXED);
+}
+
+bool tiledBlocked(Map& map, NodeId node) {
+	TiledFile* file = map.tiles;
+	NodeId tile = node >> TILED_TILE_SHIFT;
+	//a drop anywhere sends every thread back to check its tile, it may have been the one
+	if (lastTile.tile != tile || lastTile.file != file ||
+	    lastTile.generation != __atomic_load_n(&(file->generation), __ATOMIC_RELAXED)) {
+		touchTile(file, tile);
+	}
+	return (map.blocked[node >> 6] >> (node & 63)) & 1;
+}
+
+void pinTile(Map& map, NodeId node) {
+	TiledFile* file = map.tiles;
+	omp_set_lock(&(file->lock));
+	installTile(file, node >> TILED_TILE_SHIFT, TILE_PINNED);
+	omp_unset_lock(&(file->lock));
+}
+
+TiledFile* pageBitset(Map& map, uint64_t budgetBytes) {
+	TiledFile* file = (TiledFile*) malloc(sizeof(TiledFile));
+	file->base = (char*)map.blocked;
+	file->bytes = bitsetWords(map) * sizeof(uint64_t);
+	file->tiles = (file->bytes + TILED_TILE_BYTES - 1) / TILED_TILE_BYTES;
+	file->budgetTiles = max((NodeId)2, (NodeId)(budgetBytes / TILED_TILE_BYTES));
+	file->flags = (uint8_t*) calloc(file->tiles, sizeof(uint8_t));
+	file->residentTiles = 0;
+	file->hand = 0;
+	file->generation = 0;
+	omp_init_lock(&(file->lock));
+	//a fault reads only its own pages, not ahead into tiles nobody asked for. Prefetching is
+	// prefetchPath's job
+	madvise(file->base, file->bytes, MADV_RANDOM);
+	map.tiles = file;
+	return file;
+}
+
+//the tiles a prefetch has gone through
+struct Prefetch {
+	NodeId previous; //skipped if it comes up again straight away
+	NodeId count;
+	NodeId limit;
+	NodeId fetched;
+};
+
+//asks for one tile. Returns false once the limit is reached
+static bool prefetchTile(TiledFile* file, NodeId tile, Prefetch& prefetch) {
+	if (tile == prefetch.previous) return true;
+	if (prefetch.count >= prefetch.limit) return false;
+	prefetch.previous = tile;
+	prefetch.count++;
+	omp_set_lock(&(file->lock));
+	if (installTile(file, tile, 0)) {
+		uint64_t offset = ((uint64_t)tile) * TILED_TILE_BYTES;
+		madvise(file->base + offset, min((uint64_t)TILED_TILE_BYTES, file->bytes - offset), MADV_WILLNEED);
+		prefetch.fetched++;
+		if (statsEnabled) threadStats()->tilesPrefetched++;
+	}
+	omp_unset_lock(&(file->lock));
+	return true;
+}
+
+NodeId prefetchPath(MetaMap* mmap, list<coord>* hlPath) {
+	Map& real = *mmap->real;
+	TiledFile* file = real.tiles;
+	if (file == NULL) return 0;
+	Prefetch prefetch = {-1, 0, file->budgetTiles / 2, 0};
+	//a Morton tile is an aligned square, so one cell of each does
+	int side = 1 << (TILED_TILE_SHIFT / 2);
+	for (list<coord>::iterator it = hlPath->begin(); it != hlPath->end(); ++it) {
+		coord corner = littleToBig(mmap, *it);
+		//the last squares also hold the leftover cells at the far edges (see bigToLittle)
+		int x1 = it->x == mmap->meta->rows - 1 ? real.rows : min(corner.x + mmap->factor, real.rows);
+		int y1 = it->y == mmap->meta->cols - 1 ? real.cols : min(corner.y + mmap->factor, real.cols);
+		for (int x = corner.x; x < x1; x = real.layout == LAYOUT_MORTON ? (x | (side - 1)) + 1 : x + 1) {
+			if (real.layout == LAYOUT_MORTON) {
+				for (int y = corner.y; y < y1; y = (y | (side - 1)) + 1) {
+					if (!prefetchTile(file, indexOf(real, x, y) >> TILED_TILE_SHIFT, prefetch)) return prefetch.fetched;
+				}
+				continue;
+			}
+			//the square's stretch of a row is contiguous
+			NodeId first = indexOf(real, x, corner.y) >> TILED_TILE_SHIFT;
+			NodeId last = indexOf(real, x, y1 - 1) >> TILED_TILE_SHIFT;
+			for (NodeId tile = first; tile <= last; tile++) {
+				if (!prefetchTile(file, tile, prefetch)) return prefetch.fetched;
+			}
+		}
+	}
+	return prefetch.fetched;
+}
@@ -0,0 +1,54 @@
+#include <stdint.h>
+
+#include "nodemap.h"
+
+#ifndef TILEDFILE_H
+#define TILEDFILE_H
+
+#include <list>
+
+using namespace std;
+
+//a map file's real bitset read a tile at a time under a memory budget, for maps whose
+// obstacles don't fit in memory. A tile is the bits of TILED_TILE_CELLS consecutive ids,
+// 128KB of the file (a 1024x1024 square of a Morton map, a band of rows of the others).
+//The bitset stays one mapping of the file, and the searches read it like any other
+// (see isBlocked): a thread only reports the tile it reads when it moves to another one.
+// Tiles not read for a while are dropped with madvise once more than the budget are in,
+// and the kernel faults them back from the file if they're needed again
+#define TILED_TILE_SHIFT 20
+#define TILED_TILE_CELLS (((NodeId)1) << TILED_TILE_SHIFT)
+#define TILED_TILE_BYTES (TILED_TILE_CELLS / 8)
+
+//flags of a tile
+#define TILE_RESIDENT   1 //read (or prefetched) since it was last dropped
+#define TILE_REFERENCED 2 //read since the clock hand last passed it
+#define TILE_PINNED     4 //written with setBlocked, the mapping's private copy of its pages
+                          // can't be dropped without losing the write
+
+struct TiledFile {
+	char* base; //the bitset, page aligned
+	uint64_t bytes;
+	NodeId tiles;
+	NodeId budgetTiles; //how many may be resident, at least 2
+	uint8_t* flags;     //TILE_* of every tile
+	NodeId residentTiles;
+	NodeId hand;        //of the clock, the next tile considered for dropping
+	//bumped whenever a tile is dropped, so threads look again at the tile they were reading
+	uint64_t generation;
+	omp_lock_t lock;    //taken to make a tile resident, or drop one
+};
+
+//pages the bitset of map, which has to lie in a file mapping, in tiles of which at most
+// budgetBytes worth stay resident
+TiledFile* pageBitset(Map& map, uint64_t budgetBytes);
+
+//setBlocked on a tiled map, before the bit is written
+void pinTile(Map& map, NodeId node);
+
+//asks the kernel for the tiles under the high level squares of hlPath, in path order, up to
+// half the budget, so the segments don't each fault their way in. Returns how many weren't
+// resident yet
+NodeId prefetchPath(MetaMap* mmap, list<coord>* hlPath);
+
+#endif